@@ -11,6 +11,7 @@
  **********************************************************************************/
 // 서보 라이브러리
 #include <Servo.h>
+#include "PulseMeter.h"
 
 // 동작 상수
 #define ALIVE 0
@@ -27,6 +28,20 @@
 #define GET 1
 #define SET 2
 #define RESET 3
+#define IDENTIFY 5
+#define BAUD 6
+
+// 식별 응답 내용: 프로토콜 버전, 보드, 핀, 지원 장치 번호, 초당 최대 보고 횟수, 최대 통신 속도
+const char DESCRIPTOR[] PROGMEM = "v=1;b=JS_Shield;p=D0-19,A0-5;d=0-8;r=40;s=1000000";
+
+// 통신 속도 협상: 0~3 번 속도, 16MHz U2X 에서 250k/500k/1M 은 오차 없음
+#define BAUD_DEFAULT 115200UL
+#define BAUD_CONFIRM_MS 1000
+const unsigned long BAUD_RATES[] PROGMEM = {115200UL, 250000UL, 500000UL, 1000000UL};
+#define BAUD_RATE_COUNT (sizeof(BAUD_RATES) / sizeof(BAUD_RATES[0]))
+boolean baudPending = false;      // 새 속도로 바꾼 뒤 호스트의 확정을 기다리는 중
+uint8_t baudCode = 0xFF;          // 지금 쓰는 BAUD_RATES 번호, 0xFF 는 BAUD_DEFAULT
+unsigned long baudSwitchedAt = 0;
 
 // val Union
 union{
@@ -56,6 +71,18 @@ int servo_pins[8]={0,0,0,0,0,0,0,0};
 // 울트라소닉 최종 값
 float lastUltrasonic = 0;
 
+// 펄스 측정(PULSEIN): 주기, HIGH 시간, 주파수를 보고 때마다 그 사이 평균으로 보냅니다.
+// D8 은 Timer1 입력 캡처(0.5us), 다른 핀과 서보/PWM 이 Timer1 을 쓰는 동안의 D8 은 핀 변화 인터럽트(4us)로 잽니다.
+#define PULSE_CHANNELS 4
+#define PULSE_CAPTURE_PIN 8
+PulseMeter pulses[PULSE_CHANNELS];
+int8_t pulsePins[PULSE_CHANNELS] = {-1, -1, -1, -1};
+volatile uint8_t *pulseInputs[PULSE_CHANNELS];
+uint8_t pulseMasks[PULSE_CHANNELS];
+uint8_t pulseLevels = 0;             // 비트 = 채널, 핀 변화 인터럽트가 마지막으로 본 값
+int8_t pulseCaptureChannel = -1;     // 입력 캡처로 재는 채널
+volatile uint16_t pulseOverflows = 0;
+
 // 버퍼
 char buffer[52];
 unsigned char prevc=0;
@@ -73,9 +100,8 @@ boolean isUltrasonic = false;
 // 전역변수 선언 종료
 
 void setup(){
-  Serial.begin(115200);
+  Serial.begin(BAUD_DEFAULT);
   initPorts();
-  delay(200);
 }
 
 void initPorts() {
@@ -86,6 +112,7 @@ void initPorts() {
 }
 
 void loop(){
+  checkBaud();
   while (Serial.available()) {
     if (Serial.available() > 0) {
       char serialRead = Serial.read();
@@ -168,11 +195,22 @@ void parseData() {
             delay(50);
           }
         }
+      } else if(device == PULSEIN) {
+        if(port == trigPin || port == echoPin) {
+          setUltrasonicMode(false);
+        }
+        startPulse(port);
       } else if(port == trigPin || port == echoPin) {
         setUltrasonicMode(false);
+        if(device == DIGITAL) {
+          releasePulse(port);
+        }
         digitals[port] = 0;
       } else {
         setUltrasonicMode(false);
+        if(device == DIGITAL) {
+          releasePulse(port);
+        }
         digitals[port] = 0;
       }
     }
@@ -186,6 +224,14 @@ void parseData() {
       callOK();
     }
     break;
+    case IDENTIFY:{
+      sendIdentify();
+    }
+    break;
+    case BAUD:{
+      setBaud(device);
+    }
+    break;
   }
 }
 
@@ -209,6 +255,7 @@ void runModule(int device) {
       setPortWritable(pin);
       int v = readBuffer(7);
       analogWrite(pin,v);
+      updatePulseCapture();
     }
     break;
     case TONE:{
@@ -227,6 +274,7 @@ void runModule(int device) {
       int v = readBuffer(7);
       if(v>=0&&v<=180){
         Servo sv = servos[searchServoPin(pin)];
+        updatePulseCapture();
         sv.attach(pin);
         sv.write(v);
       }
@@ -258,6 +306,14 @@ void sendPinValues() {
     sendUltrasonic();  
     callOK();
   }
+
+  updatePulseCapture();
+  for (int i = 0; i < PULSE_CHANNELS; i++) {
+    if(pulsePins[i] >= 0) {
+      sendPulse(i);
+      callOK();
+    }
+  }
 }
 
 void setUltrasonicMode(boolean mode) {
@@ -289,6 +345,155 @@ void sendUltrasonic() {
   writeEnd();
 }
 
+int findPulse(int pin) {
+  for (int i = 0; i < PULSE_CHANNELS; i++) {
+    if(pulsePins[i] == pin) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// 이미 재는 핀이면 그대로 두고, 빈 채널이 없으면 무시합니다.
+void startPulse(int pin) {
+  if(pin < 2 || pin > 13 || findPulse(pin) >= 0) {
+    return;
+  }
+  int channel = findPulse(-1);
+  if(channel < 0) {
+    return;
+  }
+  digitals[pin] = 1;
+  pinMode(pin, INPUT);
+  uint8_t oldSREG = SREG;
+  cli();
+  pulsePins[channel] = pin;
+  attachPulse(channel);
+  SREG = oldSREG;
+}
+
+void releasePulse(int pin) {
+  int channel = findPulse(pin);
+  if(channel < 0) {
+    return;
+  }
+  uint8_t oldSREG = SREG;
+  cli();
+  if(channel == pulseCaptureChannel) {
+    stopCapture();
+  }
+  *digitalPinToPCMSK(pin) &= ~bit(digitalPinToPCMSKbit(pin));
+  pulsePins[channel] = -1;
+  SREG = oldSREG;
+  digitals[pin] = 0;
+}
+
+// 인터럽트를 끈 채로 부릅니다.
+void attachPulse(int channel) {
+  int pin = pulsePins[channel];
+  if(pin == PULSE_CAPTURE_PIN && !isTimer1Busy()) {
+    pulses[channel].begin(1);
+    pulseCaptureChannel = channel;
+    startCapture();
+    return;
+  }
+  pulses[channel].begin(0);
+  pulseInputs[channel] = portInputRegister(digitalPinToPort(pin));
+  pulseMasks[channel] = digitalPinToBitMask(pin);
+  bitWrite(pulseLevels, channel, (*pulseInputs[channel] & pulseMasks[channel]) != 0);
+  *digitalPinToPCMSK(pin) |= bit(digitalPinToPCMSKbit(pin));
+  PCICR |= bit(digitalPinToPCICRbit(pin));
+}
+
+// 서보 라이브러리와 9, 10번 PWM 이 Timer1 을 씁니다.
+boolean isTimer1Busy() {
+  return servo_pins[0] != 0 || (TCCR1A & (_BV(COM1A1) | _BV(COM1B1)));
+}
+
+// Timer1 을 다른 곳에서 쓰기 시작하면 D8 을 핀 변화 인터럽트로 넘깁니다.
+void updatePulseCapture() {
+  if(pulseCaptureChannel < 0 || !isTimer1Busy()) {
+    return;
+  }
+  uint8_t oldSREG = SREG;
+  cli();
+  int channel = pulseCaptureChannel;
+  stopCapture();
+  attachPulse(channel);
+  SREG = oldSREG;
+}
+
+void startCapture() {
+  TCCR1A = 0;
+  TCCR1B = _BV(ICNC1) | _BV(ICES1) | _BV(CS11);   // 잡음 제거, 상승 에지부터, 1/8 분주
+  TIFR1 = _BV(ICF1) | _BV(TOV1);
+  TIMSK1 = _BV(ICIE1) | _BV(TOIE1);
+}
+
+// 서보가 가져간 게 아니면 아두이노 기본 설정(8비트 위상 보정 PWM, 1/64 분주)으로 돌려놓습니다.
+void stopCapture() {
+  TIMSK1 &= ~(_BV(ICIE1) | _BV(TOIE1));
+  if(servo_pins[0] == 0) {
+    TCCR1A = (TCCR1A & (_BV(COM1A1) | _BV(COM1B1))) | _BV(WGM10);
+    TCCR1B = _BV(CS11) | _BV(CS10);
+  }
+  pulseCaptureChannel = -1;
+}
+
+ISR(TIMER1_OVF_vect) {
+  pulseOverflows++;
+}
+
+// 캡처 직전에 넘침이 났는데 아직 처리되지 않았으면 여기서 셉니다.
+ISR(TIMER1_CAPT_vect) {
+  uint16_t capture = ICR1;
+  uint16_t overflows = pulseOverflows;
+  if((TIFR1 & _BV(TOV1)) && capture < 0x8000) {
+    overflows++;
+  }
+  uint8_t level = (TCCR1B & _BV(ICES1)) != 0;
+  TCCR1B ^= _BV(ICES1);
+  TIFR1 = _BV(ICF1);
+  pulses[pulseCaptureChannel].edge(level, ((uint32_t)overflows << 16) | capture);
+}
+
+void pulsePinChange() {
+  unsigned long now = micros();
+  for (uint8_t i = 0; i < PULSE_CHANNELS; i++) {
+    if(pulsePins[i] < 0 || i == pulseCaptureChannel) {
+      continue;
+    }
+    uint8_t level = (*pulseInputs[i] & pulseMasks[i]) != 0;
+    if(level != bitRead(pulseLevels, i)) {
+      bitWrite(pulseLevels, i, level);
+      pulses[i].edge(level, now);
+    }
+  }
+}
+
+ISR(PCINT0_vect) {
+  pulsePinChange();
+}
+
+ISR(PCINT2_vect) {
+  pulsePinChange();
+}
+
+/** 펄스 측정 값, 주기(us) HIGH 시간(us) 주파수(Hz) 순서의 float 세 개
+    0xFF 0x55 5 주기 HIGH 주파수 핀 PULSEIN 0x0D 0x0A
+*/
+void sendPulse(int channel) {
+  const PulseReading &reading = pulses[channel].take();
+  writeHead();
+  writeSerial(5);
+  writeFloat(reading.period);
+  writeFloat(reading.high);
+  writeFloat(reading.frequency);
+  writeSerial(pulsePins[channel]);
+  writeSerial(PULSEIN);
+  writeEnd();
+}
+
 void sendDigitalValue(int pinNumber) {
   pinMode(pinNumber,INPUT);
   writeHead();
@@ -332,8 +537,12 @@ void sendString(String s){
   }
 }
 
-void sendFloat(float value){ 
+void sendFloat(float value){
   writeSerial(2);
+  writeFloat(value);
+}
+
+void writeFloat(float value){
   val.floatVal = value;
   writeSerial(val.byteVal[0]);
   writeSerial(val.byteVal[1]);
@@ -384,12 +593,80 @@ int searchServoPin(int pin){
 }
 
 void setPortWritable(int pin) {
+  releasePulse(pin);
   if(digitals[pin] == 0) {
     digitals[pin] = 1;
     pinMode(pin, OUTPUT);
   } 
 }
 
+/** 식별 응답(엔트리->PC), 한 번의 왕복으로 보드를 알아볼 수 있게 합니다.
+    0xFF 0x55 4 길이 "v=1;b=...;h=빌드해시" 0 ALIVE 0x0D 0x0A
+*/
+void sendIdentify(){
+  uint8_t len = strlen_P(DESCRIPTOR);
+  uint16_t hash = buildHash();
+  writeHead();
+  writeSerial(4);
+  writeSerial(len + 7);
+  for (uint8_t i = 0; i < len; i++) {
+    writeSerial(pgm_read_byte(DESCRIPTOR + i));
+  }
+  writeSerial(';');
+  writeSerial('h');
+  writeSerial('=');
+  for (int8_t shift = 12; shift >= 0; shift -= 4) {
+    writeSerial("0123456789abcdef"[(hash >> shift) & 15]);
+  }
+  writeSerial(0);
+  writeSerial(ALIVE);
+  writeEnd();
+}
+
+// 컴파일 시각의 FNV-1a 해시, 빌드마다 달라집니다.
+uint16_t buildHash(){
+  const char *s = PSTR(__DATE__ " " __TIME__);
+  uint32_t hash = 2166136261UL;
+  for (char c; (c = pgm_read_byte(s)) != 0; s++) {
+    hash ^= (uint8_t)c;
+    hash *= 16777619UL;
+  }
+  return hash ^ (hash >> 16);
+}
+
+/** 통신 속도 변경(PC->엔트리), 응답을 보낸 뒤 새 속도로 바꿉니다.
+    지금 쓰는 속도의 번호를 다시 받으면 그 속도를 확정합니다.
+    0xFF 0x55 3 번호(short) 0 ALIVE 0x0D 0x0A
+*/
+void setBaud(uint8_t code){
+  if (code >= BAUD_RATE_COUNT) {
+    return;
+  }
+  writeHead();
+  sendShort(code);
+  writeSerial(0);
+  writeSerial(ALIVE);
+  writeEnd();
+  if (code == baudCode) {
+    baudPending = false;
+    return;
+  }
+  Serial.flush();
+  Serial.begin(pgm_read_dword(&BAUD_RATES[code]));
+  baudCode = code;
+  baudPending = true;
+  baudSwitchedAt = millis();
+}
+
+// 새 속도에서 확정을 받지 못하면 기본 속도로 돌아갑니다.
+void checkBaud(){
+  if (baudPending && millis() - baudSwitchedAt >= BAUD_CONFIRM_MS) {
+    baudPending = false;
+    baudCode = 0xFF;
+    Serial.begin(BAUD_DEFAULT);
+  }
+}
+
 void callOK(){
   writeSerial(0xff);
   writeSerial(0x55);
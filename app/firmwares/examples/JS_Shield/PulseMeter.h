@@ -0,0 +1,85 @@
+#ifndef PulseMeter_h
+#define PulseMeter_h
+
+#include <Arduino.h>
+
+#define PULSE_TIMEOUT_MS 1000      // no edge this long reads as a stopped signal
+
+struct PulseReading {
+  float period;                    // us
+  float high;                      // us
+  float frequency;                 // Hz
+};
+
+// Continuous pulse measurement on one pin. edge() runs in the capture or
+// pin-change interrupt with a timestamp in ticks of 1 / 2^tickShift us and
+// only adds to the sums; take() runs in loop() and turns what arrived since
+// the last call into averages. A signal slower than the report interval keeps
+// its last averages until PULSE_TIMEOUT_MS passes without an edge.
+class PulseMeter {
+public:
+  PulseMeter() {
+    begin(0);
+  }
+
+  void begin(uint8_t tickShift) {
+    this->tickShift = tickShift;
+    hasRise = false;
+    periodSum = highSum = 0;
+    periods = highs = 0;
+    reading.period = reading.high = reading.frequency = 0;
+    lastActivity = millis();
+  }
+
+  void edge(uint8_t level, uint32_t ticks) {
+    if (level) {
+      if (hasRise) {
+        periodSum += ticks - lastRise;
+        periods++;
+      }
+      lastRise = ticks;
+      hasRise = true;
+    } else if (hasRise) {
+      highSum += ticks - lastRise;
+      highs++;
+    }
+  }
+
+  const PulseReading &take() {
+    uint8_t oldSREG = SREG;
+    cli();
+    uint32_t period = periodSum, high = highSum;
+    uint16_t periodCount = periods, highCount = highs;
+    periodSum = highSum = 0;
+    periods = highs = 0;
+    SREG = oldSREG;
+
+    unsigned long now = millis();
+    if (periodCount || highCount) {
+      lastActivity = now;
+    } else if (now - lastActivity >= PULSE_TIMEOUT_MS) {
+      reading.period = reading.high = reading.frequency = 0;
+    }
+    if (periodCount) {
+      reading.period = (float)period / periodCount / (1 << tickShift);
+      reading.frequency = 1000000.0 / reading.period;
+    }
+    if (highCount) {
+      reading.high = (float)high / highCount / (1 << tickShift);
+    }
+    return reading;
+  }
+
+private:
+  uint8_t tickShift;
+  bool hasRise;
+  uint32_t lastRise;
+  uint32_t periodSum;
+  uint32_t highSum;
+  uint16_t periods;
+  uint16_t highs;
+  PulseReading reading;
+  unsigned long lastActivity;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef ChannelFilter_h
+#define ChannelFilter_h
+
+#include <stdint.h>
+
+#define FILTER_MEDIAN_MAX 5        // largest median window
+#define FILTER_REFRESH_MS 250      // deadband still reports this often
+
+// Per-channel filter chain, run in integer math on every new sample:
+//   median of the last N samples -> EMA -> debounce -> report deadband
+// Every stage starts out off, so an unconfigured channel passes samples
+// through unchanged and reports each one.
+class ChannelFilter {
+public:
+  ChannelFilter() {
+    configure(0, 0, 0, 0);
+  }
+
+  // debounceMs: a new value must hold this long before it is accepted
+  // emaAlpha  : weight of a new sample in 1/256, 0 turns the EMA off
+  // median    : window size, 0 or 1 turns it off
+  // deadband  : report only when the value moved at least this much
+  void configure(uint16_t debounceMs, uint8_t emaAlpha, uint8_t median, uint16_t deadband) {
+    this->debounceMs = debounceMs;
+    this->emaAlpha = emaAlpha;
+    this->median = median > FILTER_MEDIAN_MAX ? FILTER_MEDIAN_MAX : median;
+    this->deadband = deadband;
+    historyCount = 0;
+    historyIndex = 0;
+    primed = false;
+    reported = false;
+  }
+
+  // Runs a raw sample through the chain and returns the filtered value
+  int16_t update(int16_t sample, uint16_t now) {
+    int16_t value = sample;
+
+    if (median > 1) {
+      history[historyIndex] = sample;
+      if (++historyIndex >= median)
+        historyIndex = 0;
+      if (historyCount < median)
+        historyCount++;
+      value = middle();
+    }
+
+    if (!primed) {
+      ema = (int32_t)value << 8;
+      accepted = candidate = value;
+      candidateSince = now;
+      primed = true;
+    }
+
+    if (emaAlpha) {
+      ema += ((((int32_t)value << 8) - ema) * emaAlpha) >> 8;
+      value = (ema + 128) >> 8;
+    }
+
+    if (value != candidate) {
+      candidate = value;
+      candidateSince = now;
+    }
+    if ((uint16_t)(now - candidateSince) >= debounceMs)
+      accepted = candidate;
+    return accepted;
+  }
+
+  // True when value should go out, deadband permitting
+  bool due(int16_t value, uint16_t now) {
+    if (deadband && reported) {
+      int16_t moved = value - lastReported;
+      if (moved < 0)
+        moved = -moved;
+      if (moved < deadband && (uint16_t)(now - reportedAt) < FILTER_REFRESH_MS)
+        return false;
+    }
+    lastReported = value;
+    reportedAt = now;
+    reported = true;
+    return true;
+  }
+
+private:
+  uint16_t debounceMs;
+  uint8_t emaAlpha;
+  uint8_t median;
+  uint16_t deadband;
+
+  int16_t history[FILTER_MEDIAN_MAX];
+  uint8_t historyCount;
+  uint8_t historyIndex;
+  int32_t ema;                // Q8
+  int16_t candidate;
+  int16_t accepted;
+  uint16_t candidateSince;
+  int16_t lastReported;
+  uint16_t reportedAt;
+  bool primed;
+  bool reported;
+
+  int16_t middle() const {
+    int16_t sorted[FILTER_MEDIAN_MAX];
+    for (uint8_t i = 0; i < historyCount; i++) {
+      int16_t v = history[i];
+      uint8_t j = i;
+      for (; j > 0 && sorted[j - 1] > v; j--)
+        sorted[j] = sorted[j - 1];
+      sorted[j] = v;
+    }
+    return sorted[historyCount / 2];
+  }
+};
+
+#endif
@@ -11,6 +11,10 @@
  **********************************************************************************/
 // 서보 라이브러리
 #include <Servo.h>
+#include "ChannelFilter.h"
+#include "PulseMeter.h"
+#include "BurstCapture.h"
+#include "SampleStream.h"
 
 // 동작 상수
 #define ALIVE 0
@@ -22,11 +26,34 @@
 #define PULSEIN 6
 #define ULTRASONIC 7
 #define TIMER 8
+#define FILTER 9
+#define SCOPE 10
+#define STREAM 11
 
 // 상태 상수
 #define GET 1
 #define SET 2
 #define RESET 3
+#define IDENTIFY 5
+#define BAUD 6
+#define STAMP 7
+
+// 식별 응답 내용: 프로토콜 버전, 보드, 핀, 지원 장치 번호, 초당 최대 보고 횟수, 최대 통신 속도
+const char DESCRIPTOR[] PROGMEM = "v=1;b=arduino_ext;p=D0-13,A0-5;d=0-11;r=40;s=1000000";
+
+// 통신 속도 협상: 0~3 번 속도, 16MHz U2X 에서 250k/500k/1M 은 오차 없음
+#define BAUD_DEFAULT 115200UL
+#define BAUD_CONFIRM_MS 1000
+const unsigned long BAUD_RATES[] PROGMEM = {115200UL, 250000UL, 500000UL, 1000000UL};
+#define BAUD_RATE_COUNT (sizeof(BAUD_RATES) / sizeof(BAUD_RATES[0]))
+boolean baudPending = false;      // 새 속도로 바꾼 뒤 호스트의 확정을 기다리는 중
+uint8_t baudCode = 0xFF;          // 지금 쓰는 BAUD_RATES 번호, 0xFF 는 BAUD_DEFAULT
+unsigned long baudSwitchedAt = 0;
+
+// 타임스탬프(STAMP 로 켜고 끔): 보고마다 직전 보고와의 간격을 4us 단위로 붙입니다.
+#define STAMP_MAX 0xFFFF
+boolean isStamping = false;
+unsigned long lastStamp = 0;
 
 // val Union
 union{
@@ -53,9 +80,51 @@ int analogs[6]={0,0,0,0,0,0};
 int digitals[14]={0,0,0,0,0,0,0,0,0,0,0,0,0,0};
 int servo_pins[8]={0,0,0,0,0,0,0,0};
 
+// 핀별 필터(디지털 0~13, 아날로그 A0~A5 = 14~19)
+ChannelFilter filters[20];
+
 // 울트라소닉 최종 값
 float lastUltrasonic = 0;
 
+// 펄스 측정(PULSEIN): 주기, HIGH 시간, 주파수를 보고 때마다 그 사이 평균으로 보냅니다.
+// D8 은 Timer1 입력 캡처(0.5us), 다른 핀과 서보/PWM 이 Timer1 을 쓰는 동안의 D8 은 핀 변화 인터럽트(4us)로 잽니다.
+#define PULSE_CHANNELS 4
+#define PULSE_CAPTURE_PIN 8
+PulseMeter pulses[PULSE_CHANNELS];
+int8_t pulsePins[PULSE_CHANNELS] = {-1, -1, -1, -1};
+volatile uint8_t *pulseInputs[PULSE_CHANNELS];
+uint8_t pulseMasks[PULSE_CHANNELS];
+uint8_t pulseLevels = 0;             // 비트 = 채널, 핀 변화 인터럽트가 마지막으로 본 값
+int8_t pulseCaptureChannel = -1;     // 입력 캡처로 재는 채널
+volatile uint16_t pulseOverflows = 0;
+
+// 버스트 캡처(SCOPE): 아날로그 한 채널을 프리러닝 ADC 인터럽트로 SRAM 에 모은 뒤 한꺼번에 보냅니다.
+// 캡처 중에는 ADC 를 쓰므로 아날로그 보고를 멈추고, 트리거가 SCOPE_TRIGGER_MS 안에 안 오면 그냥 모읍니다.
+#define SCOPE_BYTES 384
+#define SCOPE_CHUNK 32               // 프레임 하나에 담는 샘플 수
+#define SCOPE_TRIGGER_MS 1000
+#define ADC_PRESCALE_10BIT 6         // 10비트 값은 분주비 64 이상(ADC 클럭 250kHz, 초당 19231 번 이하)에서만 씁니다.
+uint8_t scopeChannel = 0;
+float scopeRate = 0;                 // 실제 샘플링 속도(Hz)
+unsigned long scopeStartedAt = 0;
+
+// 연속 스트림(STREAM): 아날로그 한두 채널을 프리러닝 ADC 로 일정한 속도로 읽어 링에 쌓고, loop() 가 기다리는 동안에도
+// STREAM_FRAME 개씩 꺼내 보냅니다. 링이 차서 버린 묶음 수는 프레임마다 같이 보냅니다.
+#define STREAM_RING 128              // 2 의 거듭제곱, 128 이하
+#define STREAM_FRAME 24              // 프레임 하나에 담는 샘플 수(두 채널이면 12 묶음)
+#define STREAM_DELTA 1
+// SCOPE 와 STREAM 은 시작할 때 서로를 멈추므로 샘플 버퍼 하나를 같이 씁니다.
+union {
+  uint8_t bytes[SCOPE_BYTES];
+  uint16_t values[STREAM_RING];
+} adcSamples;
+BurstCapture<SCOPE_BYTES> scope(adcSamples.bytes);
+SampleStream<STREAM_RING> stream(adcSamples.values);
+uint8_t streamPins[2] = {0, 0};
+float streamRate = 0;                // 채널당 실제 샘플링 속도(Hz)
+boolean streamDelta = false;
+uint8_t streamSeq = 0;
+
 // 버퍼
 char buffer[52];
 unsigned char prevc=0;
@@ -73,9 +142,8 @@ boolean isUltrasonic = false;
 // 전역변수 선언 종료
 
 void setup(){
-  Serial.begin(115200);
+  Serial.begin(BAUD_DEFAULT);
   initPorts();
-  delay(200);
 }
 
 void initPorts() {
@@ -86,15 +154,28 @@ void initPorts() {
 }
 
 void loop(){
+  checkBaud();
   while (Serial.available()) {
     if (Serial.available() > 0) {
       char serialRead = Serial.read();
       setPinValue(serialRead&0xff);
     }
   } 
-  delay(15);
+  waitStreaming(15);
   sendPinValues();
-  delay(10);
+  waitStreaming(10);
+}
+
+// 스트림 중에는 기다리는 동안에도 링을 비웁니다.
+void waitStreaming(unsigned long ms) {
+  if(!stream.running()) {
+    delay(ms);
+    return;
+  }
+  unsigned long startedAt = millis();
+  while (millis() - startedAt < ms) {
+    sendStream();
+  }
 }
 
 void setPinValue(unsigned char c) {
@@ -168,11 +249,22 @@ void parseData() {
             delay(50);
           }
         }
+      } else if(device == PULSEIN) {
+        if(port == trigPin || port == echoPin) {
+          setUltrasonicMode(false);
+        }
+        startPulse(port);
       } else if(port == trigPin || port == echoPin) {
         setUltrasonicMode(false);
+        if(device == DIGITAL) {
+          releasePulse(port);
+        }
         digitals[port] = 0;
       } else {
         setUltrasonicMode(false);
+        if(device == DIGITAL) {
+          releasePulse(port);
+        }
         digitals[port] = 0;
       }
     }
@@ -186,6 +278,20 @@ void parseData() {
       callOK();
     }
     break;
+    case IDENTIFY:{
+      sendIdentify();
+    }
+    break;
+    case BAUD:{
+      setBaud(device);
+    }
+    break;
+    case STAMP:{
+      isStamping = device;
+      lastStamp = micros();
+      callOK();
+    }
+    break;
   }
 }
 
@@ -209,6 +315,7 @@ void runModule(int device) {
       setPortWritable(pin);
       int v = readBuffer(7);
       analogWrite(pin,v);
+      updatePulseCapture();
     }
     break;
     case TONE:{
@@ -227,6 +334,7 @@ void runModule(int device) {
       int v = readBuffer(7);
       if(v>=0&&v<=180){
         Servo sv = servos[searchServoPin(pin)];
+        updatePulseCapture();
         sv.attach(pin);
         sv.write(v);
       }
@@ -236,20 +344,38 @@ void runModule(int device) {
       lastTime = millis()/1000.0; 
     }
     break;
+    case SCOPE:{
+      // 속도(Hz), 샘플 수, 비트 수(8/10), 트리거(0 없음, 1 상승, 2 하강), 트리거 레벨(0~1023)
+      startScope(pin, (uint16_t)readShort(7), readShort(9), readBuffer(11), readBuffer(12), readShort(13));
+    }
+    break;
+    case STREAM:{
+      // 두 번째 채널(0xFF 면 없음), 채널당 속도(Hz, 0 이면 멈춤), 방식(0 8비트, 1 델타)
+      startStream(pin, readBuffer(7), (uint16_t)readShort(8), readBuffer(10));
+    }
+    break;
+    case FILTER:{
+      // 디바운스(ms), EMA 가중치(/256), 중간값 창 크기, 보고 데드밴드
+      if(pin < 20) {
+        filters[pin].configure(readShort(7), readBuffer(9), readBuffer(10), readShort(11));
+      }
+    }
+    break;
   }
 }
 
 void sendPinValues() {  
   int pinNumber = 0;
   for (pinNumber = 0; pinNumber < 12; pinNumber++) {
-    if(digitals[pinNumber] == 0) {
-      sendDigitalValue(pinNumber);
+    if(digitals[pinNumber] == 0 && sendDigitalValue(pinNumber)) {
       callOK();
     }
   }
-  for (pinNumber = 0; pinNumber < 6; pinNumber++) {
-    if(analogs[pinNumber] == 0) {
-      sendAnalogValue(pinNumber);
+  if(scope.armed() && millis() - scopeStartedAt >= SCOPE_TRIGGER_MS) {
+    scope.force();
+  }
+  for (pinNumber = 0; pinNumber < 6 && !scope.busy() && !stream.running(); pinNumber++) {
+    if(analogs[pinNumber] == 0 && sendAnalogValue(pinNumber)) {
       callOK();
     }
   }
@@ -258,6 +384,212 @@ void sendPinValues() {
     sendUltrasonic();  
     callOK();
   }
+
+  updatePulseCapture();
+  for (int i = 0; i < PULSE_CHANNELS; i++) {
+    if(pulsePins[i] >= 0) {
+      sendPulse(i);
+      callOK();
+    }
+  }
+
+  if(scope.done()) {
+    sendScope();
+  }
+}
+
+void startScope(int channel, uint16_t rate, uint16_t count, uint8_t bits, uint8_t edge, uint16_t level) {
+  stopScope();
+  stopStream();
+  if(channel >= 6 || count == 0 || rate == 0) {
+    return;
+  }
+  uint8_t prescale;
+  uint16_t decimation;
+  scopeRate = pickAdcRate(rate, bits == 10 ? ADC_PRESCALE_10BIT : 4, prescale, decimation);
+  scopeChannel = channel;
+  scopeStartedAt = millis();
+
+  uint8_t oldSREG = SREG;
+  cli();
+  scope.arm(count, bits == 10, edge, level, decimation);
+  ADMUX = _BV(REFS0) | (bits == 10 ? 0 : _BV(ADLAR)) | channel;
+  ADCSRB = 0;
+  ADCSRA = _BV(ADEN) | _BV(ADSC) | _BV(ADATE) | _BV(ADIF) | _BV(ADIE) | prescale;
+  SREG = oldSREG;
+}
+
+// 프리러닝 변환 속도(16MHz / 분주비 / 13)를 솎아내서 요청 속도에 맞춥니다. 오차가 1% 안이면
+// 느린 변환(정확한 10비트)을, 아니면 가장 가까운 쪽을 씁니다. 분주비 16 은 초당 76923 번입니다.
+// 분주비는 2^minPrescale 보다 작아지지 않습니다.
+float pickAdcRate(unsigned long rate, uint8_t minPrescale, uint8_t &prescale, uint16_t &decimation) {
+  prescale = 7;
+  decimation = 1;
+  float bestError = -1;
+  for (uint8_t p = 7; p >= minPrescale; p--) {
+    unsigned long base = F_CPU / 13 >> p;
+    unsigned long d = (base + rate / 2) / rate;
+    if(d == 0) {
+      d = 1;
+    }
+    float error = fabs((float)base / d - rate);
+    if(bestError < 0 || error + 1 < bestError) {
+      bestError = error;
+      prescale = p;
+      decimation = d;
+    }
+    if(error <= rate / 100.0) {
+      break;
+    }
+  }
+  return (float)(F_CPU / 13 >> prescale) / decimation;
+}
+
+void stopScope() {
+  uint8_t oldSREG = SREG;
+  cli();
+  scope.reset();
+  restoreAdc();
+  SREG = oldSREG;
+}
+
+// analogRead() 가 쓰는 아두이노 기본 설정(1/128 분주, 한 번씩 변환)
+void restoreAdc() {
+  ADCSRA = _BV(ADEN) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+}
+
+// 채널 두 개를 번갈아 읽을 때는 sample() 이 다음 다음 변환의 채널을 알려줍니다.
+ISR(ADC_vect) {
+  if(stream.running()) {
+    ADMUX = _BV(REFS0) | streamPins[stream.sample(ADC)];
+    return;
+  }
+  scope.sample(scope.tenBit() ? ADC : ADCH);
+  if(scope.done()) {
+    restoreAdc();
+  }
+}
+
+// 속도는 채널당 값이고, 두 채널이면 변환을 두 배로 돌립니다. 맞춘 실제 속도를 먼저 한 번 보냅니다.
+void startStream(int first, uint8_t second, uint16_t rate, uint8_t mode) {
+  stopScope();
+  stopStream();
+  if(first >= 6 || rate == 0) {
+    return;
+  }
+  uint8_t channels = second < 6 ? 2 : 1;
+  uint8_t prescale;
+  uint16_t decimation;
+  streamRate = pickAdcRate((unsigned long)rate * channels, mode == STREAM_DELTA ? ADC_PRESCALE_10BIT : 4,
+                           prescale, decimation) / channels;
+  streamPins[0] = first;
+  streamPins[1] = channels == 2 ? second : first;
+  streamDelta = mode == STREAM_DELTA;
+  streamSeq = 0;
+
+  writeHead();
+  sendFloat(streamRate);
+  writeSerial(first);
+  writeSerial(STREAM);
+  writeEnd();
+
+  uint8_t oldSREG = SREG;
+  cli();
+  stream.begin(channels, decimation);
+  ADMUX = _BV(REFS0) | first;
+  ADCSRB = 0;
+  ADCSRA = _BV(ADEN) | _BV(ADSC) | _BV(ADATE) | _BV(ADIF) | _BV(ADIE) | prescale;
+  SREG = oldSREG;
+}
+
+void stopStream() {
+  uint8_t oldSREG = SREG;
+  cli();
+  if(stream.running()) {
+    stream.end();
+    restoreAdc();
+  }
+  SREG = oldSREG;
+}
+
+/** 연속 스트림, 링에 STREAM_FRAME 개가 모일 때마다 보냅니다.
+    0xFF 0x55 9 순번 버린 묶음 수(short) 플래그 샘플... 첫 채널 STREAM 0x0D 0x0A
+    플래그는 1 이 델타, 2 가 두 채널(A, B 번갈아)입니다. 8비트는 값 >> 2 를 한 바이트씩,
+    델타는 채널마다 첫 값을 2바이트로 쓰고 이후는 직전 값과의 차(-127~127) 한 바이트, 넘치면 0x80 뒤에 2바이트 값입니다.
+    0x0D 뒤에는 SCOPE 처럼 0x00 을 끼웁니다.
+*/
+void sendStream() {
+  if(stream.available() < STREAM_FRAME) {
+    return;
+  }
+  uint8_t channels = stream.channelCount();
+  uint16_t overruns = stream.overruns();
+  writeHead();
+  writeSerial(9);
+  writeStuffed(streamSeq++);
+  writeStuffed(overruns & 0xff);
+  writeStuffed(overruns >> 8);
+  writeStuffed((streamDelta ? 1 : 0) | (channels == 2 ? 2 : 0));
+  uint16_t last[2] = {0, 0};
+  for (uint8_t i = 0; i < STREAM_FRAME; i++) {
+    uint16_t value = stream.pop();
+    uint8_t channel = i % channels;
+    if(!streamDelta) {
+      writeStuffed(value >> 2);
+      continue;
+    }
+    int delta = (int)value - (int)last[channel];
+    if(i >= channels && delta >= -127 && delta <= 127) {
+      writeStuffed((uint8_t)delta);
+    } else {
+      if(i >= channels) {
+        writeStuffed(0x80);
+      }
+      writeStuffed(value & 0xff);
+      writeStuffed(value >> 8);
+    }
+    last[channel] = value;
+  }
+  writeSerial(streamPins[0]);
+  writeSerial(STREAM);
+  writeEnd();
+}
+
+/** 버스트 캡처 결과, SCOPE_CHUNK 샘플씩 나눠 보냅니다.
+    0xFF 0x55 8 속도(float) 시작 위치(short) 플래그 샘플... 채널 SCOPE 0x0D 0x0A
+    플래그는 1 이 마지막 조각, 2 가 10비트(2바이트) 샘플입니다.
+    샘플에는 어떤 값이든 올 수 있어서, 8 과 채널 사이에서는 0x0D 뒤에 0x00 을 하나 끼워 0x0D 0x0A 를 막습니다.
+*/
+void sendScope() {
+  uint8_t width = scope.tenBit() ? 2 : 1;
+  uint16_t total = scope.count();
+  for (uint16_t offset = 0; offset < total; offset += SCOPE_CHUNK) {
+    uint16_t end = offset + SCOPE_CHUNK < total ? offset + SCOPE_CHUNK : total;
+    writeHead();
+    writeSerial(8);
+    val.floatVal = scopeRate;
+    for (int i = 0; i < 4; i++) {
+      writeStuffed(val.byteVal[i]);
+    }
+    writeStuffed(offset & 0xff);
+    writeStuffed(offset >> 8);
+    writeStuffed((end == total ? 1 : 0) | (width == 2 ? 2 : 0));
+    for (uint16_t i = offset * width; i < end * width; i++) {
+      writeStuffed(scope.byteAt(i));
+    }
+    writeSerial(scopeChannel);
+    writeSerial(SCOPE);
+    writeEnd();
+    callOK();
+  }
+  scope.reset();
+}
+
+void writeStuffed(unsigned char c) {
+  writeSerial(c);
+  if(c == 13) {
+    writeSerial(0);
+  }
 }
 
 void setUltrasonicMode(boolean mode) {
@@ -275,6 +607,7 @@ void sendUltrasonic() {
   digitalWrite(trigPin, LOW);
 
   float value = pulseIn(echoPin, HIGH, 30000) / 29.0 / 2.0;
+  unsigned long sampledAt = micros();
 
   if(value == 0) {
     value = lastUltrasonic;
@@ -283,27 +616,196 @@ void sendUltrasonic() {
   }
   writeHead();
   sendFloat(value);
+  writeStamp(sampledAt);
   writeSerial(trigPin);
   writeSerial(echoPin);
   writeSerial(ULTRASONIC);
   writeEnd();
 }
 
-void sendDigitalValue(int pinNumber) {
+int findPulse(int pin) {
+  for (int i = 0; i < PULSE_CHANNELS; i++) {
+    if(pulsePins[i] == pin) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// 이미 재는 핀이면 그대로 두고, 빈 채널이 없으면 무시합니다.
+void startPulse(int pin) {
+  if(pin < 2 || pin > 13 || findPulse(pin) >= 0) {
+    return;
+  }
+  int channel = findPulse(-1);
+  if(channel < 0) {
+    return;
+  }
+  digitals[pin] = 1;
+  pinMode(pin, INPUT);
+  uint8_t oldSREG = SREG;
+  cli();
+  pulsePins[channel] = pin;
+  attachPulse(channel);
+  SREG = oldSREG;
+}
+
+void releasePulse(int pin) {
+  int channel = findPulse(pin);
+  if(channel < 0) {
+    return;
+  }
+  uint8_t oldSREG = SREG;
+  cli();
+  if(channel == pulseCaptureChannel) {
+    stopCapture();
+  }
+  *digitalPinToPCMSK(pin) &= ~bit(digitalPinToPCMSKbit(pin));
+  pulsePins[channel] = -1;
+  SREG = oldSREG;
+  digitals[pin] = 0;
+}
+
+// 인터럽트를 끈 채로 부릅니다.
+void attachPulse(int channel) {
+  int pin = pulsePins[channel];
+  if(pin == PULSE_CAPTURE_PIN && !isTimer1Busy()) {
+    pulses[channel].begin(1);
+    pulseCaptureChannel = channel;
+    startCapture();
+    return;
+  }
+  pulses[channel].begin(0);
+  pulseInputs[channel] = portInputRegister(digitalPinToPort(pin));
+  pulseMasks[channel] = digitalPinToBitMask(pin);
+  bitWrite(pulseLevels, channel, (*pulseInputs[channel] & pulseMasks[channel]) != 0);
+  *digitalPinToPCMSK(pin) |= bit(digitalPinToPCMSKbit(pin));
+  PCICR |= bit(digitalPinToPCICRbit(pin));
+}
+
+// 서보 라이브러리와 9, 10번 PWM 이 Timer1 을 씁니다.
+boolean isTimer1Busy() {
+  return servo_pins[0] != 0 || (TCCR1A & (_BV(COM1A1) | _BV(COM1B1)));
+}
+
+// Timer1 을 다른 곳에서 쓰기 시작하면 D8 을 핀 변화 인터럽트로 넘깁니다.
+void updatePulseCapture() {
+  if(pulseCaptureChannel < 0 || !isTimer1Busy()) {
+    return;
+  }
+  uint8_t oldSREG = SREG;
+  cli();
+  int channel = pulseCaptureChannel;
+  stopCapture();
+  attachPulse(channel);
+  SREG = oldSREG;
+}
+
+void startCapture() {
+  TCCR1A = 0;
+  TCCR1B = _BV(ICNC1) | _BV(ICES1) | _BV(CS11);   // 잡음 제거, 상승 에지부터, 1/8 분주
+  TIFR1 = _BV(ICF1) | _BV(TOV1);
+  TIMSK1 = _BV(ICIE1) | _BV(TOIE1);
+}
+
+// 서보가 가져간 게 아니면 아두이노 기본 설정(8비트 위상 보정 PWM, 1/64 분주)으로 돌려놓습니다.
+void stopCapture() {
+  TIMSK1 &= ~(_BV(ICIE1) | _BV(TOIE1));
+  if(servo_pins[0] == 0) {
+    TCCR1A = (TCCR1A & (_BV(COM1A1) | _BV(COM1B1))) | _BV(WGM10);
+    TCCR1B = _BV(CS11) | _BV(CS10);
+  }
+  pulseCaptureChannel = -1;
+}
+
+ISR(TIMER1_OVF_vect) {
+  pulseOverflows++;
+}
+
+// 캡처 직전에 넘침이 났는데 아직 처리되지 않았으면 여기서 셉니다.
+ISR(TIMER1_CAPT_vect) {
+  uint16_t capture = ICR1;
+  uint16_t overflows = pulseOverflows;
+  if((TIFR1 & _BV(TOV1)) && capture < 0x8000) {
+    overflows++;
+  }
+  uint8_t level = (TCCR1B & _BV(ICES1)) != 0;
+  TCCR1B ^= _BV(ICES1);
+  TIFR1 = _BV(ICF1);
+  pulses[pulseCaptureChannel].edge(level, ((uint32_t)overflows << 16) | capture);
+}
+
+void pulsePinChange() {
+  unsigned long now = micros();
+  for (uint8_t i = 0; i < PULSE_CHANNELS; i++) {
+    if(pulsePins[i] < 0 || i == pulseCaptureChannel) {
+      continue;
+    }
+    uint8_t level = (*pulseInputs[i] & pulseMasks[i]) != 0;
+    if(level != bitRead(pulseLevels, i)) {
+      bitWrite(pulseLevels, i, level);
+      pulses[i].edge(level, now);
+    }
+  }
+}
+
+ISR(PCINT0_vect) {
+  pulsePinChange();
+}
+
+ISR(PCINT2_vect) {
+  pulsePinChange();
+}
+
+/** 펄스 측정 값, 주기(us) HIGH 시간(us) 주파수(Hz) 순서의 float 세 개
+    0xFF 0x55 5 주기 HIGH 주파수 [간격] 핀 PULSEIN 0x0D 0x0A
+*/
+void sendPulse(int channel) {
+  unsigned long sampledAt = micros();
+  const PulseReading &reading = pulses[channel].take();
+  writeHead();
+  writeSerial(5);
+  writeFloat(reading.period);
+  writeFloat(reading.high);
+  writeFloat(reading.frequency);
+  writeStamp(sampledAt);
+  writeSerial(pulsePins[channel]);
+  writeSerial(PULSEIN);
+  writeEnd();
+}
+
+// 필터를 거친 값이 데드밴드 안에 있으면 보내지 않고 false 를 돌려줍니다.
+boolean sendDigitalValue(int pinNumber) {
   pinMode(pinNumber,INPUT);
+  unsigned long sampledAt = micros();
+  uint16_t now = millis();
+  int value = filters[pinNumber].update(digitalRead(pinNumber), now);
+  if(!filters[pinNumber].due(value, now)) {
+    return false;
+  }
   writeHead();
-  sendFloat(digitalRead(pinNumber));  
+  sendFloat(value);  
+  writeStamp(sampledAt);
   writeSerial(pinNumber);
   writeSerial(DIGITAL);
   writeEnd();
+  return true;
 }
 
-void sendAnalogValue(int pinNumber) {
+boolean sendAnalogValue(int pinNumber) {
+  unsigned long sampledAt = micros();
+  uint16_t now = millis();
+  int value = filters[14 + pinNumber].update(analogRead(pinNumber), now);
+  if(!filters[14 + pinNumber].due(value, now)) {
+    return false;
+  }
   writeHead();
-  sendFloat(analogRead(pinNumber));  
+  sendFloat(value);  
+  writeStamp(sampledAt);
   writeSerial(pinNumber);
   writeSerial(ANALOG);
   writeEnd();
+  return true;
 }
 
 void writeBuffer(int index,unsigned char c){
@@ -323,6 +825,32 @@ void writeSerial(unsigned char c){
   Serial.write(c);
 }
 
+/** 타임스탬프, 값 바로 뒤 포트 앞에 붙습니다. 포트와 장치는 여전히 프레임 끝에서 읽힙니다.
+    간격이 STAMP_MAX 이면 262ms 이상 끊긴 것입니다.
+    0x0D 0x0A 가 프레임 중간에 생기지 않도록 간격을 조금 늘리고 다음 간격에서 돌려받습니다.
+*/
+void writeStamp(unsigned long sampledAt){
+  if (!isStamping) {
+    return;
+  }
+  long elapsed = sampledAt - lastStamp;
+  unsigned long delta = elapsed > 0 ? (unsigned long)elapsed >> 2 : 0;
+  if (delta >= STAMP_MAX) {
+    delta = STAMP_MAX;
+    lastStamp = sampledAt;
+  } else {
+    if ((delta >> 8) == 13) {
+      delta = 14 << 8;
+    }
+    if ((delta & 0xff) == 10 || (delta & 0xff) == 13) {
+      delta++;
+    }
+    lastStamp += delta << 2;
+  }
+  writeSerial(delta & 0xff);
+  writeSerial(delta >> 8);
+}
+
 void sendString(String s){
   int l = s.length();
   writeSerial(4);
@@ -334,6 +862,10 @@ void sendString(String s){
 
 void sendFloat(float value){ 
   writeSerial(2);
+  writeFloat(value);
+}
+
+void writeFloat(float value){
   val.floatVal = value;
   writeSerial(val.byteVal[0]);
   writeSerial(val.byteVal[1]);
@@ -384,12 +916,80 @@ int searchServoPin(int pin){
 }
 
 void setPortWritable(int pin) {
+  releasePulse(pin);
   if(digitals[pin] == 0) {
     digitals[pin] = 1;
     pinMode(pin, OUTPUT);
   } 
 }
 
+/** 식별 응답(엔트리->PC), 한 번의 왕복으로 보드를 알아볼 수 있게 합니다.
+    0xFF 0x55 4 길이 "v=1;b=...;h=빌드해시" 0 ALIVE 0x0D 0x0A
+*/
+void sendIdentify(){
+  uint8_t len = strlen_P(DESCRIPTOR);
+  uint16_t hash = buildHash();
+  writeHead();
+  writeSerial(4);
+  writeSerial(len + 7);
+  for (uint8_t i = 0; i < len; i++) {
+    writeSerial(pgm_read_byte(DESCRIPTOR + i));
+  }
+  writeSerial(';');
+  writeSerial('h');
+  writeSerial('=');
+  for (int8_t shift = 12; shift >= 0; shift -= 4) {
+    writeSerial("0123456789abcdef"[(hash >> shift) & 15]);
+  }
+  writeSerial(0);
+  writeSerial(ALIVE);
+  writeEnd();
+}
+
+// 컴파일 시각의 FNV-1a 해시, 빌드마다 달라집니다.
+uint16_t buildHash(){
+  const char *s = PSTR(__DATE__ " " __TIME__);
+  uint32_t hash = 2166136261UL;
+  for (char c; (c = pgm_read_byte(s)) != 0; s++) {
+    hash ^= (uint8_t)c;
+    hash *= 16777619UL;
+  }
+  return hash ^ (hash >> 16);
+}
+
+/** 통신 속도 변경(PC->엔트리), 응답을 보낸 뒤 새 속도로 바꿉니다.
+    지금 쓰는 속도의 번호를 다시 받으면 그 속도를 확정합니다.
+    0xFF 0x55 3 번호(short) 0 ALIVE 0x0D 0x0A
+*/
+void setBaud(uint8_t code){
+  if (code >= BAUD_RATE_COUNT) {
+    return;
+  }
+  writeHead();
+  sendShort(code);
+  writeSerial(0);
+  writeSerial(ALIVE);
+  writeEnd();
+  if (code == baudCode) {
+    baudPending = false;
+    return;
+  }
+  Serial.flush();
+  Serial.begin(pgm_read_dword(&BAUD_RATES[code]));
+  baudCode = code;
+  baudPending = true;
+  baudSwitchedAt = millis();
+}
+
+// 새 속도에서 확정을 받지 못하면 기본 속도로 돌아갑니다.
+void checkBaud(){
+  if (baudPending && millis() - baudSwitchedAt >= BAUD_CONFIRM_MS) {
+    baudPending = false;
+    baudCode = 0xFF;
+    Serial.begin(BAUD_DEFAULT);
+  }
+}
+
 void callOK(){
   writeSerial(0xff);
   writeSerial(0x55);
@@ -0,0 +1,113 @@
+#ifndef BurstCapture_h
+#define BurstCapture_h
+
+#include <stdint.h>
+
+#define TRIGGER_NONE 0
+#define TRIGGER_RISING 1
+#define TRIGGER_FALLING 2
+
+// One-shot capture of a single ADC channel into SRAM. sample() runs in the
+// ADC interrupt with every free-running conversion: it drops the first one
+// (the longer start-up conversion), keeps one in `decimation` after that,
+// waits for the trigger crossing and then fills the buffer with 8-bit samples
+// (one byte) or 10-bit samples (two bytes, little endian). The sketch owns
+// the ADC registers and the BYTES long buffer, which it may share with
+// anything that never runs alongside a capture, and streams it once done().
+template <uint16_t BYTES>
+class BurstCapture {
+public:
+  BurstCapture(uint8_t *buffer) : data(buffer), state(IDLE) {}
+
+  // level is on the 10-bit scale for either sample size
+  void arm(uint16_t count, bool tenBit, uint8_t edge, uint16_t level, uint16_t decimation) {
+    uint16_t most = tenBit ? BYTES / 2 : BYTES;
+    length = count > most ? most : count;
+    wide = tenBit;
+    this->edge = edge;
+    this->level = tenBit ? level : level >> 2;
+    this->decimation = decimation ? decimation : 1;
+    skip = 1;
+    filled = 0;
+    primed = false;
+    state = edge == TRIGGER_NONE ? RUNNING : ARMED;
+  }
+
+  void sample(uint16_t value) {
+    if (state != ARMED && state != RUNNING)
+      return;
+    if (skip) {
+      skip--;
+      return;
+    }
+    skip = decimation - 1;
+    if (state == ARMED) {
+      bool crossed = primed && (edge == TRIGGER_RISING ? last < level && value >= level
+                                                       : last > level && value <= level);
+      last = value;
+      primed = true;
+      if (!crossed)
+        return;
+      state = RUNNING;
+    }
+    if (wide) {
+      data[filled * 2] = value;
+      data[filled * 2 + 1] = value >> 8;
+    } else {
+      data[filled] = value;
+    }
+    if (++filled >= length)
+      state = DONE;
+  }
+
+  // Starts filling without waiting for the trigger
+  void force() {
+    if (state == ARMED)
+      state = RUNNING;
+  }
+
+  void reset() {
+    state = IDLE;
+  }
+
+  bool armed() const {
+    return state == ARMED;
+  }
+
+  bool busy() const {
+    return state == ARMED || state == RUNNING;
+  }
+
+  bool done() const {
+    return state == DONE;
+  }
+
+  bool tenBit() const {
+    return wide;
+  }
+
+  uint16_t count() const {
+    return filled;
+  }
+
+  uint8_t byteAt(uint16_t i) const {
+    return data[i];
+  }
+
+private:
+  enum { IDLE, ARMED, RUNNING, DONE };
+
+  uint8_t *const data;
+  volatile uint8_t state;
+  volatile uint16_t filled;
+  uint16_t length;
+  uint16_t decimation;
+  uint16_t skip;
+  uint16_t level;
+  uint16_t last;
+  uint8_t edge;
+  bool wide;
+  bool primed;
+};
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef SampleStream_h
+#define SampleStream_h
+
+#include <Arduino.h>
+
+// Continuous sampling of one or two ADC channels into a ring that loop()
+// drains. sample() runs in the ADC interrupt with every free-running
+// conversion and returns the channel index to load into ADMUX: a new mux
+// setting only applies to the conversion after the one already running, so
+// it always selects the channel after the one in flight and the channels
+// alternate. The first conversion (the longer start-up one) is dropped, then
+// one set (a sample from each channel) in `decimation` is kept. A set that
+// does not fit in the ring is dropped whole and counted as an overrun, so the
+// channels never slip against each other. SIZE must be a power of two, at
+// most 128. The sketch owns the ring buffer of SIZE values, which it may share
+// with anything that never runs alongside the stream.
+template <uint8_t SIZE>
+class SampleStream {
+public:
+  SampleStream(uint16_t *buffer) : data(buffer), active(false) {}
+
+  void begin(uint8_t channels, uint16_t decimation) {
+    this->channels = channels == 2 ? 2 : 1;
+    this->decimation = decimation ? decimation : 1;
+    head = tail = 0;
+    lost = 0;
+    phase = 0;
+    keep = false;
+    skip = true;
+    done = inflight = 0;
+    active = true;
+  }
+
+  // Drops what is left in the ring, its buffer may be reused from here on
+  void end() {
+    active = false;
+    tail = head;
+  }
+
+  bool running() const {
+    return active;
+  }
+
+  uint8_t channelCount() const {
+    return channels;
+  }
+
+  uint8_t sample(uint16_t value) {
+    uint8_t channel = done;
+    done = inflight;
+    inflight = inflight + 1 < channels ? inflight + 1 : 0;
+    if (skip) {
+      skip = false;
+      return inflight;
+    }
+    if (channel == 0) {
+      keep = phase == 0;
+      if (++phase >= decimation)
+        phase = 0;
+      if (keep && (uint8_t)(head - tail) > SIZE - channels) {
+        keep = false;
+        lost++;
+      }
+    }
+    if (keep) {
+      data[head & (SIZE - 1)] = value;
+      head++;
+    }
+    return inflight;
+  }
+
+  uint8_t available() const {
+    return (uint8_t)(head - tail);
+  }
+
+  uint16_t pop() {
+    uint16_t value = data[tail & (SIZE - 1)];
+    tail++;
+    return value;
+  }
+
+  // Sets dropped since begin()
+  uint16_t overruns() const {
+    uint8_t oldSREG = SREG;
+    cli();
+    uint16_t value = lost;
+    SREG = oldSREG;
+    return value;
+  }
+
+private:
+  uint16_t *const data;
+  volatile uint8_t head;
+  volatile uint8_t tail;
+  volatile uint16_t lost;
+  volatile bool active;
+  uint16_t decimation;
+  uint16_t phase;
+  uint8_t channels;
+  uint8_t done;                    // channel of the conversion that just finished
+  uint8_t inflight;                // channel of the conversion already running
+  bool keep;
+  bool skip;
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef EdgeCapture_h
+#define EdgeCapture_h
+
+#include <Arduino.h>
+
+#define EDGE_QUEUE_SIZE 16       // power of two
+#define EDGE_DEBOUNCE_MS 5       // edges closer than this to the last one are contact bounce
+#define EDGE_AGE_MAX 8191        // ms, 13 bits in the event report
+
+struct EdgeEvent {
+  uint8_t slot;
+  uint8_t level;
+  uint16_t time;                 // millis() & 0xFFFF
+};
+
+// Edge queue for SLOTS input pins. edge() runs in the pin-change interrupt
+// and pop() in loop(). An edge inside the debounce window is dropped; calling
+// edge() again from loop() with the current level (interrupts off) records a
+// change the window swallowed, so the queue always ends on the real level.
+template <uint8_t SLOTS>
+class EdgeCapture {
+public:
+  EdgeCapture() : head(0), tail(0) {
+    for (uint8_t i = 0; i < SLOTS; i++) {
+      lastLevel[i] = 0xFF;
+      lastTime[i] = 0;
+    }
+  }
+
+  // Starts tracking a slot from its current level, without an event
+  void arm(uint8_t slot, uint8_t level, uint16_t now) {
+    lastLevel[slot] = level;
+    lastTime[slot] = now - EDGE_DEBOUNCE_MS;
+  }
+
+  void disarm(uint8_t slot) {
+    lastLevel[slot] = 0xFF;
+  }
+
+  bool armed(uint8_t slot) const {
+    return lastLevel[slot] != 0xFF;
+  }
+
+  void edge(uint8_t slot, uint8_t level, uint16_t now) {
+    if (!armed(slot) || level == lastLevel[slot] || (uint16_t)(now - lastTime[slot]) < EDGE_DEBOUNCE_MS)
+      return;
+    uint8_t next = (head + 1) & (EDGE_QUEUE_SIZE - 1);
+    if (next == tail)
+      return;                    // full: the level reports still carry the state
+    events[head].slot = slot;
+    events[head].level = level;
+    events[head].time = now;
+    head = next;
+    lastLevel[slot] = level;
+    lastTime[slot] = now;
+  }
+
+  bool pop(EdgeEvent &event) {
+    if (tail == head)
+      return false;
+    event = events[tail];
+    tail = (tail + 1) & (EDGE_QUEUE_SIZE - 1);
+    return true;
+  }
+
+  // Milliseconds since the event, clamped to what the report can carry
+  static uint16_t age(const EdgeEvent &event, uint16_t now) {
+    uint16_t age = now - event.time;
+    return age > EDGE_AGE_MAX ? EDGE_AGE_MAX : age;
+  }
+
+private:
+  EdgeEvent events[EDGE_QUEUE_SIZE];
+  volatile uint8_t head;
+  volatile uint8_t tail;
+  uint8_t lastLevel[SLOTS];      // 0xFF = not armed
+  uint16_t lastTime[SLOTS];
+};
+
+#endif
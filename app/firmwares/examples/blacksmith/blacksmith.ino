@@ -14,6 +14,8 @@
 #include <LiquidCrystal_I2C.h>
 #include <SoftwareSerial.h>
 #include "U8glib.h"
+#include "EdgeCapture.h"
+#include "PulseMeter.h"
 
 // Module Constant //핀설정
 #define ALIVE 0
@@ -31,12 +33,27 @@
 #define RGBLED 12
 #define DCMOTOR 13
 #define OLED 14
+#define EDGE 15
 
 // State Constant
 #define GET 1
 #define SET 2
 #define MODULE 3
 #define RESET 4
+#define IDENTIFY 5
+#define BAUD 6
+
+// 식별 응답 내용: 프로토콜 버전, 보드, 핀, 지원 장치 번호, 초당 최대 보고 횟수, 최대 통신 속도
+const char DESCRIPTOR[] PROGMEM = "v=1;b=blacksmith;p=D4-13,A0-5;d=0-15;r=40;s=1000000";
+
+// 통신 속도 협상: 0~3 번 속도, 16MHz U2X 에서 250k/500k/1M 은 오차 없음
+#define BAUD_DEFAULT 115200UL
+#define BAUD_CONFIRM_MS 1000
+const unsigned long BAUD_RATES[] PROGMEM = {115200UL, 250000UL, 500000UL, 1000000UL};
+#define BAUD_RATE_COUNT (sizeof(BAUD_RATES) / sizeof(BAUD_RATES[0]))
+boolean baudPending = false;      // 새 속도로 바꾼 뒤 호스트의 확정을 기다리는 중
+uint8_t baudCode = 0xFF;          // 지금 쓰는 BAUD_RATES 번호, 0xFF 는 BAUD_DEFAULT
+unsigned long baudSwitchedAt = 0;
 
 Servo servos[8];
 Servo sv;
@@ -63,14 +80,42 @@ int servo_pins[8] = {0, 0, 0, 0, 0, 0, 0, 0};
 
 // Ultrasonic             //초음파 센서
 float lastUltrasonic = 0;
+
+// Pulse                  //펄스 측정(PULSEIN): 주기, HIGH 시간, 주파수
+// 핀 변화 인터럽트는 SoftwareSerial 이 쓰고 있어서 Timer1 입력 캡처가 있는 D8 만 잴 수 있다.
+// 9, 10번 PWM 이 Timer1 을 쓰는 동안에는 멈추고, 신호가 끊긴 것처럼 0 을 보낸다.
+#define PULSE_CAPTURE_PIN 8
+#define PULSE 5
+PulseMeter pulse;
+boolean isPulse = false;
+boolean isPulseCapturing = false;
+volatile uint16_t pulseOverflows = 0;
 int trigPin = 13;
 int echoPin = 12;
 
 // bluetooth                //블루투스
-String makeBtString;
+// softSerial 수신 데이터를 힙 할당 없이 보관하는 링 버퍼
+#define BT_BUFFER_SIZE 64       // 2의 거듭제곱
+#define BT_BUFFER_MASK (BT_BUFFER_SIZE - 1)
+#define BT_FRAME_MAX 32         // 한 프레임에 보내는 최대 바이트
+#define BT_IDLE_MS 5            // 수신이 이만큼 멈추면 줄바꿈 없이도 전송
+byte btBuffer[BT_BUFFER_SIZE];
+byte btHead = 0;
+byte btTail = 0;
+unsigned long btLastRxTime = 0;
 int softSerialRX = 2;
 int softSerialTX = 3;
 
+// 디지털 입력 변화 포착
+// SoftwareSerial 이 핀 변화 인터럽트(PCINT)를 모두 쓰고 있어서, Timer0 비교 인터럽트로
+// 약 1ms 마다 D4~D13 을 읽어 보고 주기 사이의 짧은 변화도 놓치지 않는다.
+#define EDGE_PIN_FIRST 4
+#define EDGE_PIN_LAST 13
+#define TYPE_EDGE 6
+EdgeCapture<EDGE_PIN_LAST + 1> edges;    // 슬롯 = 핀 번호
+volatile uint16_t edgeMask = 0;          // 비트 = 핀 번호, 포착 중인 입력 핀
+uint16_t edgeLevels = 0;                 // 마지막으로 읽은 핀 값
+
 // LCD
 String lastLcdDataLine0;
 String lastLcdDataLine1;
@@ -92,11 +137,12 @@ boolean isBluetooth = false;
 // End Public Value
 
 void setup() {                            //초기화
-  Serial.begin(115200);                   //시리얼 115200
+  Serial.begin(BAUD_DEFAULT);             //시리얼 115200
   softSerial.begin(9600);                 //블루투스 9600
   initPorts();
   initLCD();
-  delay(200);
+  OCR0A = 0x80;                           //millis 와 반 주기 어긋나게, PWM 6번을 쓰면 그 값으로 바뀌어도 주기는 같음
+  TIMSK0 |= _BV(OCIE0A);                  //핀 변화 샘플링 시작
 }
 
 void initPorts() {                          //디지털 포트 초기화(4~14)
@@ -117,6 +163,7 @@ void initLCD() {                          //lcd 초기화
 }
 
 void loop() {                    //반복 시리얼 값 , 블루투스 값 받기
+  checkBaud();
   while (Serial.available()) {
     if (Serial.available() > 0) {
       char serialRead = Serial.read();
@@ -125,8 +172,7 @@ void loop() {                    //반복 시리얼 값 , 블루투스 값 받
   }
   while (softSerial.available()) {
     if (softSerial.available() > 0) {
-      char softSerialRead = softSerial.read();
-      makeBtString += softSerialRead;
+      btPush(softSerial.read());
     }
   }
   delay(15);
@@ -218,8 +264,14 @@ void parseData() {
             setBluetoothMode(true);
           }
         }
+        else if (device == PULSEIN) {
+          startPulse(port);
+        }
         else if (port == trigPin || port == echoPin) {
           setUltrasonicMode(false);
+          if (device == DIGITAL) {
+            releasePulse(port);
+          }
           digitals[port] = 0;
         }
         else if (device != READ_BLUETOOTH && port == softSerialRX ) {
@@ -233,6 +285,9 @@ void parseData() {
           digitals[port] = 0;
         }
         else {
+          if (device == DIGITAL) {
+            releasePulse(port);
+          }
           digitals[port] = 0;
         }
       }
@@ -250,6 +305,14 @@ void parseData() {
         callOK();
       }
       break;
+    case IDENTIFY: {
+        sendIdentify();
+      }
+      break;
+    case BAUD: {
+        setBaud(device);
+      }
+      break;
   }
 }
 
@@ -272,6 +335,7 @@ void runSet(int device) {
         setPortWritable(pin);
         int v = readBuffer(7);
         analogWrite(pin, v);
+        updatePulseCapture();
       }
       break;
     case TONE: {
@@ -300,6 +364,10 @@ void runSet(int device) {
           TCCR1B=rg[1];
           TIMSK1=rg[3];
           OCR1A=rg[2];
+          if (isPulseCapturing) {               //서보가 카운터를 건드린 동안의 값은 버리고 다시 잰다
+            pulse.begin(1);
+            startCapture();
+          }
         }
       }
       break;
@@ -403,13 +471,13 @@ void runModule(int device) {
       }
       break;
     case WRITE_BLUETOOTH: {
-        char softSerialTemp[32];
         int arrayNum = 7;
-        for (int i = 0; i < 17; i++) {
-          softSerialTemp[i] = readBuffer(arrayNum);
+        for (int i = 0; i < 16; i++) {
+          char softSerialWrite = readBuffer(arrayNum);
+          if (softSerialWrite == 0) break;
+          softSerial.write(softSerialWrite);
           arrayNum += 2;
         }
-        softSerial.write(softSerialTemp);
       }
       break;
     default:
@@ -419,6 +487,7 @@ void runModule(int device) {
 
 void sendPinValues() {   //핀 값 보내기
   int pinNumber = 0;
+  sendEdgeEvents();
   for (pinNumber = 4; pinNumber < 14; pinNumber++) {
     if (digitals[pinNumber] == 0) {
       sendDigitalValue(pinNumber);
@@ -438,7 +507,184 @@ void sendPinValues() {   //핀 값 보내기
   }
 
   if (isBluetooth) {
-    sendBluetooth();
+    // 완성된 줄이 여러 개 쌓였으면 한 번에 모두 보낸다
+    do {
+      sendBluetooth();
+      callOK();
+    } while (btFrameLength() > 0);
+  }
+
+  if (isPulse) {
+    updatePulseCapture();
+    sendPulse();
+    callOK();
+  }
+}
+
+void startPulse(int pin) {
+  if (pin != PULSE_CAPTURE_PIN || isPulse) {
+    return;
+  }
+  digitals[pin] = 1;
+  pinMode(pin, INPUT);
+  isPulse = true;
+  pulse.begin(1);
+  updatePulseCapture();
+}
+
+void releasePulse(int pin) {
+  if (pin != PULSE_CAPTURE_PIN || !isPulse) {
+    return;
+  }
+  if (isPulseCapturing) {
+    stopCapture();
+  }
+  isPulse = false;
+  digitals[pin] = 0;
+}
+
+// 서보는 움직인 뒤 detach 하고 Timer1 설정을 되돌려 놓으므로 PWM 만 본다.
+boolean isTimer1Busy() {
+  return TCCR1A & (_BV(COM1A1) | _BV(COM1B1));
+}
+
+void updatePulseCapture() {
+  if (isPulseCapturing && isTimer1Busy()) {
+    stopCapture();
+  } else if (isPulse && !isPulseCapturing && !isTimer1Busy()) {
+    pulse.begin(1);
+    startCapture();
+  }
+}
+
+void startCapture() {
+  TCCR1A = 0;
+  TCCR1B = _BV(ICNC1) | _BV(ICES1) | _BV(CS11);   // 잡음 제거, 상승 에지부터, 1/8 분주(0.5us)
+  TIFR1 = _BV(ICF1) | _BV(TOV1);
+  TIMSK1 = _BV(ICIE1) | _BV(TOIE1);
+  isPulseCapturing = true;
+}
+
+// 아두이노 기본 설정(8비트 위상 보정 PWM, 1/64 분주)으로 돌려놓는다.
+void stopCapture() {
+  TIMSK1 &= ~(_BV(ICIE1) | _BV(TOIE1));
+  TCCR1A = (TCCR1A & (_BV(COM1A1) | _BV(COM1B1))) | _BV(WGM10);
+  TCCR1B = _BV(CS11) | _BV(CS10);
+  isPulseCapturing = false;
+}
+
+ISR(TIMER1_OVF_vect) {
+  pulseOverflows++;
+}
+
+// 캡처 직전에 넘침이 났는데 아직 처리되지 않았으면 여기서 센다.
+ISR(TIMER1_CAPT_vect) {
+  uint16_t capture = ICR1;
+  uint16_t overflows = pulseOverflows;
+  if ((TIFR1 & _BV(TOV1)) && capture < 0x8000) {
+    overflows++;
+  }
+  uint8_t level = (TCCR1B & _BV(ICES1)) != 0;
+  TCCR1B ^= _BV(ICES1);
+  TIFR1 = _BV(ICF1);
+  pulse.edge(level, ((uint32_t)overflows << 16) | capture);
+}
+
+// 0xFF 0x55 5 주기(us) HIGH(us) 주파수(Hz) 8 PULSEIN 0x0D 0x0A, 값은 모두 float
+void sendPulse() {
+  const PulseReading &reading = pulse.take();
+  writeHead();
+  writeSerial(PULSE);
+  writeFloat(reading.period);
+  writeFloat(reading.high);
+  writeFloat(reading.frequency);
+  writeSerial(PULSE_CAPTURE_PIN);
+  writeSerial(PULSEIN);
+  writeEnd();
+}
+
+// 비트 위치 = 핀 번호 (PD4~PD7 = D4~D7, PB0~PB5 = D8~D13)
+uint16_t readEdgePins() {
+  return ((uint16_t)(PINB & 0x3F) << 8) | (PIND & 0xF0);
+}
+
+ISR(TIMER0_COMPA_vect) {
+  uint16_t levels = readEdgePins() & edgeMask;
+  uint16_t changed = levels ^ edgeLevels;
+  if (changed == 0) {
+    return;
+  }
+  edgeLevels = levels;
+  uint16_t now = millis();
+  for (uint8_t pin = EDGE_PIN_FIRST; pin <= EDGE_PIN_LAST; pin++) {
+    if (changed & (1 << pin)) {
+      edges.edge(pin, (levels >> pin) & 1, now);
+    }
+  }
+}
+
+// 입력으로 읽고 있는 핀만 포착한다. 디바운스 동안 놓친 마지막 변화도 여기서 채운다.
+void updateEdgeMask() {
+  uint16_t mask = 0;
+  for (int pin = EDGE_PIN_FIRST; pin <= EDGE_PIN_LAST; pin++) {
+    if (digitals[pin] == 0 && !(*portModeRegister(digitalPinToPort(pin)) & digitalPinToBitMask(pin))) {
+      mask |= 1 << pin;
+    }
+  }
+
+  uint8_t oldSREG = SREG;
+  cli();
+  uint16_t levels = readEdgePins() & mask;
+  uint16_t now = millis();
+  for (uint8_t pin = EDGE_PIN_FIRST; pin <= EDGE_PIN_LAST; pin++) {
+    uint8_t level = (levels >> pin) & 1;
+    if (!(mask & (1 << pin))) {
+      edges.disarm(pin);
+    } else if (!edges.armed(pin)) {
+      edges.arm(pin, level, now);
+    } else {
+      edges.edge(pin, level, now);
+    }
+  }
+  edgeMask = mask;
+  edgeLevels = levels;
+  SREG = oldSREG;
+}
+
+// 핀마다 쌓인 변화를 묶어 보낸다: ff 55 6 개수 (레벨, 경과 ms)... 핀 EDGE \r\n
+void sendEdgeEvents() {
+  EdgeEvent events[EDGE_QUEUE_SIZE];
+  uint8_t count = 0;
+
+  updateEdgeMask();
+  while (count < EDGE_QUEUE_SIZE && edges.pop(events[count])) {
+    count++;
+  }
+
+  uint16_t now = millis();
+  for (int pin = EDGE_PIN_FIRST; pin <= EDGE_PIN_LAST && count > 0; pin++) {
+    uint8_t pinCount = 0;
+    for (uint8_t i = 0; i < count; i++) {
+      if (events[i].slot == pin) pinCount++;
+    }
+    if (pinCount == 0) {
+      continue;
+    }
+
+    writeHead();
+    writeSerial(TYPE_EDGE);
+    writeSerial(pinCount);
+    for (uint8_t i = 0; i < count; i++) {
+      if (events[i].slot == pin) {
+        // 두 바이트 모두 최상위 비트가 1 이라 줄바꿈(13, 10)과 겹치지 않음
+        uint16_t age = EdgeCapture<EDGE_PIN_LAST + 1>::age(events[i], now);
+        writeSerial(0x80 | (events[i].level << 6) | ((age >> 7) & 0x3F));
+        writeSerial(0x80 | (age & 0x7F));
+      }
+    }
+    writeSerial(pin);
+    writeSerial(EDGE);
+    writeEnd();
     callOK();
   }
 }
@@ -453,10 +699,42 @@ void setUltrasonicMode(boolean mode) {
 void setBluetoothMode(boolean mode) {
   isBluetooth = mode;
   if (!mode) {
-    makeBtString = "";
+    btHead = 0;
+    btTail = 0;
   }
 }
 
+void btPush(byte c) {
+  if (c == '\r') return;   // 호스트 프레임 구분자(\r\n)와 겹치지 않도록 버림
+  byte next = (btHead + 1) & BT_BUFFER_MASK;
+  if (next == btTail) {
+    btTail = (btTail + 1) & BT_BUFFER_MASK;   // 가득 차면 가장 오래된 바이트를 버림
+  }
+  btBuffer[btHead] = c;
+  btHead = next;
+  btLastRxTime = millis();
+}
+
+byte btAvailable() {
+  return (btHead - btTail) & BT_BUFFER_MASK;
+}
+
+// 이번에 보낼 프레임 길이(줄바꿈 포함)를 버퍼 안에서 바로 찾는다.
+// 줄바꿈이 있으면 그 줄까지, 없으면 프레임이 꽉 찼거나 수신이 멈췄을 때만 보낸다.
+byte btFrameLength() {
+  byte available = btAvailable();
+  byte limit = available < BT_FRAME_MAX ? available : BT_FRAME_MAX;
+  for (byte i = 0; i < limit; i++) {
+    if (btBuffer[(btTail + i) & BT_BUFFER_MASK] == '\n') {
+      return i + 1;
+    }
+  }
+  if (limit == BT_FRAME_MAX || (limit > 0 && millis() - btLastRxTime >= BT_IDLE_MS)) {
+    return limit;
+  }
+  return 0;
+}
+
 void sendUltrasonic() {
   digitalWrite(trigPin, LOW);
   delayMicroseconds(2);
@@ -480,12 +758,21 @@ void sendUltrasonic() {
 }
 
 void sendBluetooth() {
+  byte l = btFrameLength();
+  byte payload = l;
+  if (l > 0 && btBuffer[(btTail + l - 1) & BT_BUFFER_MASK] == '\n') {
+    payload--;    // 줄바꿈은 보내지 않음
+  }
   writeHead();
-  sendString(makeBtString);
+  writeSerial(4);
+  writeSerial(payload);
+  for (byte i = 0; i < payload; i++) {
+    writeSerial(btBuffer[(btTail + i) & BT_BUFFER_MASK]);
+  }
+  btTail = (btTail + l) & BT_BUFFER_MASK;
   writeSerial(softSerialRX);
   writeSerial(READ_BLUETOOTH);
   writeEnd();
-  makeBtString = "";
 }
 
 void sendDigitalValue(int pinNumber) {
@@ -536,17 +823,12 @@ void writeSerial(unsigned char c) {
   Serial.write(c);
 }
 
-void sendString(String s) {
-  int l = s.length();
-  writeSerial(4);
-  writeSerial(l);
-  for (int i = 0; i < l; i++) {
-    writeSerial(s.charAt(i));
-  }
-}
-
 void sendFloat(float value) {
   writeSerial(2);
+  writeFloat(value);
+}
+
+void writeFloat(float value) {
   val.floatVal = value;
   writeSerial(val.byteVal[0]);
   writeSerial(val.byteVal[1]);
@@ -597,12 +879,80 @@ int searchServoPin(int pin) {
 }
 
 void setPortWritable(int pin) {
+  releasePulse(pin);
   if (digitals[pin] == 0) {
     digitals[pin] = 1;
     pinMode(pin, OUTPUT);
   }
 }
 
+/** 식별 응답(엔트리->PC), 한 번의 왕복으로 보드를 알아볼 수 있게 합니다.
+    0xFF 0x55 4 길이 "v=1;b=...;h=빌드해시" 0 ALIVE 0x0D 0x0A
+*/
+void sendIdentify() {
+  uint8_t len = strlen_P(DESCRIPTOR);
+  uint16_t hash = buildHash();
+  writeHead();
+  writeSerial(4);
+  writeSerial(len + 7);
+  for (uint8_t i = 0; i < len; i++) {
+    writeSerial(pgm_read_byte(DESCRIPTOR + i));
+  }
+  writeSerial(';');
+  writeSerial('h');
+  writeSerial('=');
+  for (int8_t shift = 12; shift >= 0; shift -= 4) {
+    writeSerial("0123456789abcdef"[(hash >> shift) & 15]);
+  }
+  writeSerial(0);
+  writeSerial(ALIVE);
+  writeEnd();
+}
+
+// 컴파일 시각의 FNV-1a 해시, 빌드마다 달라집니다.
+uint16_t buildHash() {
+  const char *s = PSTR(__DATE__ " " __TIME__);
+  uint32_t hash = 2166136261UL;
+  for (char c; (c = pgm_read_byte(s)) != 0; s++) {
+    hash ^= (uint8_t)c;
+    hash *= 16777619UL;
+  }
+  return hash ^ (hash >> 16);
+}
+
+/** 통신 속도 변경(PC->엔트리), 응답을 보낸 뒤 새 속도로 바꿉니다.
+    지금 쓰는 속도의 번호를 다시 받으면 그 속도를 확정합니다.
+    0xFF 0x55 3 번호(short) 0 ALIVE 0x0D 0x0A
+*/
+void setBaud(uint8_t code) {
+  if (code >= BAUD_RATE_COUNT) {
+    return;
+  }
+  writeHead();
+  sendShort(code);
+  writeSerial(0);
+  writeSerial(ALIVE);
+  writeEnd();
+  if (code == baudCode) {
+    baudPending = false;
+    return;
+  }
+  Serial.flush();
+  Serial.begin(pgm_read_dword(&BAUD_RATES[code]));
+  baudCode = code;
+  baudPending = true;
+  baudSwitchedAt = millis();
+}
+
+// 새 속도에서 확정을 받지 못하면 기본 속도로 돌아갑니다.
+void checkBaud() {
+  if (baudPending && millis() - baudSwitchedAt >= BAUD_CONFIRM_MS) {
+    baudPending = false;
+    baudCode = 0xFF;
+    Serial.begin(BAUD_DEFAULT);
+  }
+}
+
 void callOK() {          //상태 확인용
   writeSerial(0xff);     //테일
   writeSerial(0x55);    //테일2
@@ -1,6 +1,7 @@
 #include <Wire.h>
 // 서보 라이브러리
 #include <Servo.h>
+#include "PulseMeter.h"
 #include "I2C_LCD.h"
 
 //핀
@@ -24,11 +25,26 @@
 
 #define FLOAT 2
 #define SHORT 3
+#define PULSE 5
 
 // 상태 상수
 #define GET 1
 #define SET 2
 #define RESET 3
+#define IDENTIFY 5
+#define BAUD 6
+
+// 식별 응답 내용: 프로토콜 버전, 보드, 핀, 지원 장치 번호, 초당 최대 보고 횟수, 최대 통신 속도
+const char DESCRIPTOR[] PROGMEM = "v=1;b=coding_box;p=D0-13,A0-5;d=0-11;r=40;s=1000000";
+
+// 통신 속도 협상: 0~3 번 속도, 16MHz U2X 에서 250k/500k/1M 은 오차 없음
+#define BAUD_DEFAULT 115200UL
+#define BAUD_CONFIRM_MS 1000
+const unsigned long BAUD_RATES[] PROGMEM = {115200UL, 250000UL, 500000UL, 1000000UL};
+#define BAUD_RATE_COUNT (sizeof(BAUD_RATES) / sizeof(BAUD_RATES[0]))
+boolean baudPending = false;      // 새 속도로 바꾼 뒤 호스트의 확정을 기다리는 중
+uint8_t baudCode = 0xFF;          // 지금 쓰는 BAUD_RATES 번호, 0xFF 는 BAUD_DEFAULT
+unsigned long baudSwitchedAt = 0;
 
 // val Union
 union {
@@ -43,16 +59,28 @@ union {
   short shortVal;
 } valShort;
 
+// 소프트웨어 PWM (BAM)
+// 하드웨어 PWM이 없는 핀(RGB LED 8, 12, 13 등)과 Timer2 핀(3, 11)은 Timer2 비교 B 인터럽트로
+// 구동합니다. 비트 b의 출력을 LSB 길이 * 2^b 동안 유지하므로 한 주기에 인터럽트는 8번입니다.
+#define BAM_CHANNELS 6
+#define BAM_PORTS 3
+#define BAM_BITS 8
+#define BAM_LSB_TICKS 2   // Timer2 틱(4us) 단위, 한 주기 2.04ms (490Hz)
+
 typedef struct {
   int pin;
   int value;
 } SoftwarePWM;
 
-SoftwarePWM RGBLeds[3] = {
-  {RGB_R_PIN, 0},
-  {RGB_G_PIN, 255},
-  {RGB_B_PIN, 0}
-};
+SoftwarePWM softPWM[BAM_CHANNELS];
+uint8_t softPWMCount = 0;
+
+// 인터럽트에서 쓰는 포트별 마스크와 비트별 출력 패턴
+volatile uint8_t *bamOut[BAM_PORTS];
+uint8_t bamMask[BAM_PORTS];
+uint8_t bamPattern[BAM_BITS][BAM_PORTS];
+volatile uint8_t bamPortCount = 0;
+volatile uint8_t bamBit = 0;
 
 // 전역변수 선언 시작
 Servo servos[8];
@@ -71,6 +99,18 @@ int servo_pins[8] = {0, 0, 0, 0, 0, 0, 0, 0};
 // 울트라소닉 최종 값
 float lastUltrasonic = 0;
 
+// 펄스 측정(PULSEIN): 주기, HIGH 시간, 주파수를 보고 때마다 그 사이 평균으로 보냅니다.
+// D8 은 Timer1 입력 캡처(0.5us), 다른 핀과 서보/PWM 이 Timer1 을 쓰는 동안의 D8 은 핀 변화 인터럽트(4us)로 잽니다.
+#define PULSE_CHANNELS 4
+#define PULSE_CAPTURE_PIN 8
+PulseMeter pulses[PULSE_CHANNELS];
+int8_t pulsePins[PULSE_CHANNELS] = {-1, -1, -1, -1};
+volatile uint8_t *pulseInputs[PULSE_CHANNELS];
+uint8_t pulseMasks[PULSE_CHANNELS];
+uint8_t pulseLevels = 0;             // 비트 = 채널, 핀 변화 인터럽트가 마지막으로 본 값
+int8_t pulseCaptureChannel = -1;     // 입력 캡처로 재는 채널
+volatile uint16_t pulseOverflows = 0;
+
 // 버퍼
 char buffer[52];
 unsigned char prevc = 0;
@@ -83,8 +123,6 @@ double currentTime = 0.0;
 
 uint8_t command_index = 0;
 
-const int CYCLE_LENGTH = 1000000 / 300;
-
 boolean isStart = false;
 boolean isUltrasonic = false;
 // 전역변수 선언 종료
@@ -109,11 +147,10 @@ byte findI2CAddress() {
 
 void setup() {
   Wire.begin();
-  Serial.begin(115200);
+  Serial.begin(BAUD_DEFAULT);
 
   initLCD();
   initPorts();
-  delay(200);
 }
 void initLCD() {
   lcdAddress = findI2CAddress();
@@ -131,6 +168,7 @@ void initPorts() {
 }
 
 void loop() {
+  checkBaud();
   while (Serial.available()) {
     if (Serial.available() > 0) {
       char serialRead = Serial.read();
@@ -138,8 +176,10 @@ void loop() {
     }
   }
 
-  //  loopRGB();
-  //  RGBLeds[2].value = map(analogRead(0), 0, 1024, 0, 255);
+  // tone()이 Timer2를 돌려주면 소프트웨어 PWM을 다시 시작합니다.
+  if (bamPortCount && !(TIMSK2 & (_BV(OCIE2A) | _BV(OCIE2B)))) {
+    bamBegin();
+  }
 
   delay(15);
   sendPinValues();
@@ -191,25 +231,118 @@ unsigned char readBuffer(int index) {
   return buffer[index];
 }
 
-void loopRGB() {
-  float dutyCycle;
-  int onTime;
-  int offTime;
+boolean isSoftwarePWMPin(int pin) {
+  uint8_t timer = digitalPinToTimer(pin);
+  return timer == NOT_ON_TIMER || timer == TIMER2A || timer == TIMER2B;
+}
 
-  for (int i = 0; i < 3; i++) {
-    dutyCycle = RGBLeds[i].value / 255.0;
-    onTime = dutyCycle * CYCLE_LENGTH;
-    offTime = CYCLE_LENGTH - onTime;
+void softPWMWrite(int pin, int value) {
+  uint8_t i;
+  for (i = 0; i < softPWMCount && softPWM[i].pin != pin; i++);
+  if (i == softPWMCount) {
+    if (softPWMCount >= BAM_CHANNELS) {
+      return;
+    }
+    softPWMCount++;
+  }
+  softPWM[i].pin = pin;
+  softPWM[i].value = value;
+  updateBAM();
+}
 
-    if (onTime > 0) {
-      digitalWrite(RGBLeds[i].pin, HIGH);
-      delayMicroseconds(onTime);
+void softPWMRemove(int pin) {
+  for (uint8_t i = 0; i < softPWMCount; i++) {
+    if (softPWM[i].pin == pin) {
+      softPWM[i] = softPWM[--softPWMCount];
+      updateBAM();
+      return;
     }
-    digitalWrite(RGBLeds[i].pin, LOW);
-    delayMicroseconds(offTime);
   }
 }
 
+// 채널 값으로 포트별 패턴을 다시 만들어 인터럽트가 쓰는 표와 한 번에 교체합니다.
+void updateBAM() {
+  volatile uint8_t *out[BAM_PORTS];
+  uint8_t mask[BAM_PORTS] = {0};
+  uint8_t pattern[BAM_BITS][BAM_PORTS] = {{0}};
+  uint8_t ports = 0;
+
+  for (uint8_t i = 0; i < softPWMCount; i++) {
+    volatile uint8_t *reg = portOutputRegister(digitalPinToPort(softPWM[i].pin));
+    uint8_t bit = digitalPinToBitMask(softPWM[i].pin);
+    uint8_t p;
+    for (p = 0; p < ports && out[p] != reg; p++);
+    if (p == ports) {
+      if (ports >= BAM_PORTS) {
+        continue;
+      }
+      out[ports++] = reg;
+    }
+    mask[p] |= bit;
+    for (uint8_t b = 0; b < BAM_BITS; b++) {
+      if ((softPWM[i].value >> b) & 1) {
+        pattern[b][p] |= bit;
+      }
+    }
+  }
+
+  uint8_t oldSREG = SREG;
+  cli();
+  for (uint8_t p = 0; p < ports; p++) {
+    bamOut[p] = out[p];
+    bamMask[p] = mask[p];
+    for (uint8_t b = 0; b < BAM_BITS; b++) {
+      bamPattern[b][p] = pattern[b][p];
+    }
+  }
+  bamPortCount = ports;
+  SREG = oldSREG;
+
+  if (ports == 0) {
+    bamEnd();
+  } else if (!(TIMSK2 & (_BV(OCIE2A) | _BV(OCIE2B)))) {
+    bamBegin();
+  }
+}
+
+void bamBegin() {
+  TIMSK2 = 0;
+  TCCR2A = _BV(WGM21);  // CTC, TOP = OCR2A
+  TCCR2B = _BV(CS22);   // clk/64, 4us
+  TCNT2 = 0;
+  OCR2A = OCR2B = BAM_LSB_TICKS - 1;
+  bamBit = 0;
+  TIFR2 = _BV(OCF2B);
+  TIMSK2 = _BV(OCIE2B);
+}
+
+void bamEnd() {
+  if (!(TIMSK2 & _BV(OCIE2B))) {
+    return;
+  }
+  TIMSK2 &= ~_BV(OCIE2B);
+  TCCR2A = _BV(WGM20);  // 아두이노 기본값(위상 정정 PWM)으로 복구
+  TCCR2B = _BV(CS22);
+}
+
+ISR(TIMER2_COMPB_vect) {
+  uint8_t bit = bamBit + 1;
+  if (bit >= BAM_BITS) {
+    bit = 0;
+  }
+  for (uint8_t p = 0; p < bamPortCount; p++) {
+    *bamOut[p] = (*bamOut[p] & ~bamMask[p]) | bamPattern[bit][p];
+  }
+  uint8_t top = (BAM_LSB_TICKS << bit) - 1;
+  OCR2A = top;
+  OCR2B = top;
+  // 다른 인터럽트로 늦어져 새 TOP을 이미 지났으면 한 바퀴(1ms) 도는 대신 이 슬롯을 다시 시작합니다.
+  if (TCNT2 >= top) {
+    TCNT2 = 0;
+  }
+  bamBit = bit;
+}
+
 void parseData() {
   isStart = false;
   int idx = readBuffer(3);
@@ -224,6 +357,8 @@ void parseData() {
             setUltrasonicMode(true);
             trigPin = readBuffer(6);
             echoPin = readBuffer(7);
+            softPWMRemove(trigPin);
+            softPWMRemove(echoPin);
             digitals[trigPin] = 1;
             digitals[echoPin] = 1;
             pinMode(trigPin, OUTPUT);
@@ -237,6 +372,8 @@ void parseData() {
               digitals[echoPin] = 0;
               trigPin = trig;
               echoPin = echo;
+              softPWMRemove(trigPin);
+              softPWMRemove(echoPin);
               digitals[trigPin] = 1;
               digitals[echoPin] = 1;
               pinMode(trigPin, OUTPUT);
@@ -244,11 +381,22 @@ void parseData() {
               delay(50);
             }
           }
+        } else if (device == PULSEIN) {
+          if (port == trigPin || port == echoPin) {
+            setUltrasonicMode(false);
+          }
+          startPulse(port);
         } else if (port == trigPin || port == echoPin) {
           setUltrasonicMode(false);
+          if (device == DIGITAL) {
+            releasePulse(port);
+          }
           digitals[port] = 0;
         } else {
           setUltrasonicMode(false);
+          if (device == DIGITAL) {
+            releasePulse(port);
+          }
           digitals[port] = 0;
         }
       }
@@ -263,6 +411,14 @@ void parseData() {
         callOK();
       }
       break;
+      case IDENTIFY: {
+        sendIdentify();
+      }
+      break;
+      case BAUD: {
+        setBaud(device);
+      }
+      break;
   }
 }
 
@@ -278,6 +434,7 @@ void runModule(int device) {
   switch (device) {
     case DIGITAL: {
         setPortWritable(pin);
+        softPWMRemove(pin);
         int v = readBuffer(7);
         digitalWrite(pin, v);
       }
@@ -285,11 +442,19 @@ void runModule(int device) {
     case PWM: {
         setPortWritable(pin);
         int v = readBuffer(7);
-        analogWrite(pin, v);
+        if (isSoftwarePWMPin(pin)) {
+          softPWMWrite(pin, v);
+        } else {
+          analogWrite(pin, v);
+          updatePulseCapture();
+        }
       }
       break;
     case TONE: {
         setPortWritable(pin);
+        softPWMRemove(pin);
+        // tone()이 Timer2를 쓰는 동안 소프트웨어 PWM은 멈춥니다(loop에서 다시 시작).
+        TIMSK2 &= ~_BV(OCIE2B);
         int hz = readShort(7);
         int ms = readShort(9);
         if (ms > 0) {
@@ -301,9 +466,11 @@ void runModule(int device) {
       break;
     case SERVO_PIN: {
         setPortWritable(pin);
+        softPWMRemove(pin);
         int v = readBuffer(7);
         if (v >= 0 && v <= 180) {
           Servo sv = servos[searchServoPin(pin)];
+          updatePulseCapture();
           sv.attach(pin);
           sv.write(v);
         }
@@ -358,6 +525,14 @@ void sendPinValues() {
     sendUltrasonic();
     callOK();
   }
+
+  updatePulseCapture();
+  for (int i = 0; i < PULSE_CHANNELS; i++) {
+    if (pulsePins[i] >= 0) {
+      sendPulse(i);
+      callOK();
+    }
+  }
 }
 
 void setUltrasonicMode(boolean mode) {
@@ -391,6 +566,155 @@ void sendUltrasonic() {
   writeEnd();
 }
 
+int findPulse(int pin) {
+  for (int i = 0; i < PULSE_CHANNELS; i++) {
+    if (pulsePins[i] == pin) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// 이미 재는 핀이면 그대로 두고, 빈 채널이 없으면 무시합니다.
+void startPulse(int pin) {
+  if (pin < 2 || pin > 13 || findPulse(pin) >= 0) {
+    return;
+  }
+  int channel = findPulse(-1);
+  if (channel < 0) {
+    return;
+  }
+  digitals[pin] = 1;
+  pinMode(pin, INPUT);
+  uint8_t oldSREG = SREG;
+  cli();
+  pulsePins[channel] = pin;
+  attachPulse(channel);
+  SREG = oldSREG;
+}
+
+void releasePulse(int pin) {
+  int channel = findPulse(pin);
+  if (channel < 0) {
+    return;
+  }
+  uint8_t oldSREG = SREG;
+  cli();
+  if (channel == pulseCaptureChannel) {
+    stopCapture();
+  }
+  *digitalPinToPCMSK(pin) &= ~bit(digitalPinToPCMSKbit(pin));
+  pulsePins[channel] = -1;
+  SREG = oldSREG;
+  digitals[pin] = 0;
+}
+
+// 인터럽트를 끈 채로 부릅니다.
+void attachPulse(int channel) {
+  int pin = pulsePins[channel];
+  if (pin == PULSE_CAPTURE_PIN && !isTimer1Busy()) {
+    pulses[channel].begin(1);
+    pulseCaptureChannel = channel;
+    startCapture();
+    return;
+  }
+  pulses[channel].begin(0);
+  pulseInputs[channel] = portInputRegister(digitalPinToPort(pin));
+  pulseMasks[channel] = digitalPinToBitMask(pin);
+  bitWrite(pulseLevels, channel, (*pulseInputs[channel] & pulseMasks[channel]) != 0);
+  *digitalPinToPCMSK(pin) |= bit(digitalPinToPCMSKbit(pin));
+  PCICR |= bit(digitalPinToPCICRbit(pin));
+}
+
+// 서보 라이브러리와 9, 10번 PWM 이 Timer1 을 씁니다.
+boolean isTimer1Busy() {
+  return servo_pins[0] != 0 || (TCCR1A & (_BV(COM1A1) | _BV(COM1B1)));
+}
+
+// Timer1 을 다른 곳에서 쓰기 시작하면 D8 을 핀 변화 인터럽트로 넘깁니다.
+void updatePulseCapture() {
+  if (pulseCaptureChannel < 0 || !isTimer1Busy()) {
+    return;
+  }
+  uint8_t oldSREG = SREG;
+  cli();
+  int channel = pulseCaptureChannel;
+  stopCapture();
+  attachPulse(channel);
+  SREG = oldSREG;
+}
+
+void startCapture() {
+  TCCR1A = 0;
+  TCCR1B = _BV(ICNC1) | _BV(ICES1) | _BV(CS11);   // 잡음 제거, 상승 에지부터, 1/8 분주
+  TIFR1 = _BV(ICF1) | _BV(TOV1);
+  TIMSK1 = _BV(ICIE1) | _BV(TOIE1);
+}
+
+// 서보가 가져간 게 아니면 아두이노 기본 설정(8비트 위상 보정 PWM, 1/64 분주)으로 돌려놓습니다.
+void stopCapture() {
+  TIMSK1 &= ~(_BV(ICIE1) | _BV(TOIE1));
+  if (servo_pins[0] == 0) {
+    TCCR1A = (TCCR1A & (_BV(COM1A1) | _BV(COM1B1))) | _BV(WGM10);
+    TCCR1B = _BV(CS11) | _BV(CS10);
+  }
+  pulseCaptureChannel = -1;
+}
+
+ISR(TIMER1_OVF_vect) {
+  pulseOverflows++;
+}
+
+// 캡처 직전에 넘침이 났는데 아직 처리되지 않았으면 여기서 셉니다.
+ISR(TIMER1_CAPT_vect) {
+  uint16_t capture = ICR1;
+  uint16_t overflows = pulseOverflows;
+  if ((TIFR1 & _BV(TOV1)) && capture < 0x8000) {
+    overflows++;
+  }
+  uint8_t level = (TCCR1B & _BV(ICES1)) != 0;
+  TCCR1B ^= _BV(ICES1);
+  TIFR1 = _BV(ICF1);
+  pulses[pulseCaptureChannel].edge(level, ((uint32_t)overflows << 16) | capture);
+}
+
+void pulsePinChange() {
+  unsigned long now = micros();
+  for (uint8_t i = 0; i < PULSE_CHANNELS; i++) {
+    if (pulsePins[i] < 0 || i == pulseCaptureChannel) {
+      continue;
+    }
+    uint8_t level = (*pulseInputs[i] & pulseMasks[i]) != 0;
+    if (level != bitRead(pulseLevels, i)) {
+      bitWrite(pulseLevels, i, level);
+      pulses[i].edge(level, now);
+    }
+  }
+}
+
+ISR(PCINT0_vect) {
+  pulsePinChange();
+}
+
+ISR(PCINT2_vect) {
+  pulsePinChange();
+}
+
+/** 펄스 측정 값, 주기(us) HIGH 시간(us) 주파수(Hz) 순서의 float 세 개
+    0xFF 0x55 5 주기 HIGH 주파수 핀 PULSEIN 0x0D 0x0A
+*/
+void sendPulse(int channel) {
+  const PulseReading &reading = pulses[channel].take();
+  writeHead();
+  writeSerial(PULSE);
+  writeFloat(reading.period);
+  writeFloat(reading.high);
+  writeFloat(reading.frequency);
+  writeSerial(pulsePins[channel]);
+  writeSerial(PULSEIN);
+  writeEnd();
+}
+
 /** 디지털 데이터 전송(엔트리->PC)
 */
 void sendDigitalValue(int pinNumber) {
@@ -442,6 +766,10 @@ void sendString(String s) {
 
 void sendFloat(float value) {
   writeSerial(FLOAT);
+  writeFloat(value);
+}
+
+void writeFloat(float value) {
   val.floatVal = value;
   writeSerial(val.byteVal[0]);
   writeSerial(val.byteVal[1]);
@@ -501,12 +829,80 @@ int searchServoPin(int pin) {
 }
 
 void setPortWritable(int pin) {
+  releasePulse(pin);
   if (digitals[pin] == 0) {
     digitals[pin] = 1;
     pinMode(pin, OUTPUT);
   }
 }
 
+/** 식별 응답(엔트리->PC), 한 번의 왕복으로 보드를 알아볼 수 있게 합니다.
+    0xFF 0x55 4 길이 "v=1;b=...;h=빌드해시" 0 ALIVE 0x0D 0x0A
+*/
+void sendIdentify() {
+  uint8_t len = strlen_P(DESCRIPTOR);
+  uint16_t hash = buildHash();
+  writeHead();
+  writeSerial(4);
+  writeSerial(len + 7);
+  for (uint8_t i = 0; i < len; i++) {
+    writeSerial(pgm_read_byte(DESCRIPTOR + i));
+  }
+  writeSerial(';');
+  writeSerial('h');
+  writeSerial('=');
+  for (int8_t shift = 12; shift >= 0; shift -= 4) {
+    writeSerial("0123456789abcdef"[(hash >> shift) & 15]);
+  }
+  writeSerial(0);
+  writeSerial(ALIVE);
+  writeEnd();
+}
+
+// 컴파일 시각의 FNV-1a 해시, 빌드마다 달라집니다.
+uint16_t buildHash() {
+  const char *s = PSTR(__DATE__ " " __TIME__);
+  uint32_t hash = 2166136261UL;
+  for (char c; (c = pgm_read_byte(s)) != 0; s++) {
+    hash ^= (uint8_t)c;
+    hash *= 16777619UL;
+  }
+  return hash ^ (hash >> 16);
+}
+
+/** 통신 속도 변경(PC->엔트리), 응답을 보낸 뒤 새 속도로 바꿉니다.
+    지금 쓰는 속도의 번호를 다시 받으면 그 속도를 확정합니다.
+    0xFF 0x55 3 번호(short) 0 ALIVE 0x0D 0x0A
+*/
+void setBaud(uint8_t code) {
+  if (code >= BAUD_RATE_COUNT) {
+    return;
+  }
+  writeHead();
+  sendShort(code);
+  writeSerial(0);
+  writeSerial(ALIVE);
+  writeEnd();
+  if (code == baudCode) {
+    baudPending = false;
+    return;
+  }
+  Serial.flush();
+  Serial.begin(pgm_read_dword(&BAUD_RATES[code]));
+  baudCode = code;
+  baudPending = true;
+  baudSwitchedAt = millis();
+}
+
+// 새 속도에서 확정을 받지 못하면 기본 속도로 돌아갑니다.
+void checkBaud() {
+  if (baudPending && millis() - baudSwitchedAt >= BAUD_CONFIRM_MS) {
+    baudPending = false;
+    baudCode = 0xFF;
+    Serial.begin(BAUD_DEFAULT);
+  }
+}
+
 void callOK() {
   writeSerial(0xff);
   writeSerial(0x55);
@@ -1,13 +1,12 @@
 #include <SoftwareServo.h>
+#include "MovingAverage.h"
 
 SoftwareServo servo1;
 
 int servoPin = 6;
 const int M_SIZE=20;
-int iii=0;
-int rotation=1000;
 int DC_ON=0; // if DC motor is use or not use:1, not;0
-int mdata[M_SIZE];
+MovingAverage<M_SIZE, MOVING_AVERAGE_ABSOLUTE> soundAverage;
 
 int sound_offset=0;
 int cds1_offset=0;
@@ -20,6 +19,16 @@ char mode;
 #define Entry_Exp 1
 #define Entry_Sen 0
 
+//SensorBoard report cadence
+#define REPORT_PERIOD_PORT 15     // analog write to this port sets the report period in ms
+#define REPORT_PERIOD_DEFAULT 20  // ms, also used for a written value of 0
+#define REPORT_PERIOD_MIN 5       // ms, a full report takes about 3 ms at 57600
+#define SERVO_REFRESH_US 20000UL
+
+unsigned long reportPeriodUs = REPORT_PERIOD_DEFAULT * 1000UL;
+unsigned long nextReportUs;
+unsigned long nextServoUs;
+
 //SAME
 void mydelay_us(unsigned int time_us)
 {
@@ -38,18 +47,19 @@ void mydelay_us(unsigned int time_us)
 
 //Made by Sang Bin Yim 20150423
 int cal_sound(){ //calculate the moving average of the sound input 
-  if(sound_offset==0)  mdata[iii]= analogRead(A0);
-  else mdata[iii]=sound_offset-analogRead(A0);
-  iii++;
-  if(iii>=M_SIZE) iii=0;
-  
-  int sensorValue=0;
-  for(int i=0; i<M_SIZE; i++){
-    sensorValue+=abs(mdata[i]); //Moving Average
-  }
-  sensorValue=sensorValue/M_SIZE; 
-  
-  return sensorValue;  
+  if(sound_offset==0) return soundAverage.add(analogRead(A0));
+  return soundAverage.add(sound_offset-analogRead(A0));
+}
+
+//Returns true once the deadline has passed and moves it one period on, so the
+//cadence does not drift. When more than a period behind it restarts from now
+//instead of sending a burst.
+boolean deadlinePassed(unsigned long &deadline, unsigned long period){
+  unsigned long now = micros();
+  if((long)(now - deadline) < 0) return false;
+  deadline += period;
+  if((long)(now - deadline) >= 0) deadline = now + period;
+  return true;
 }
 
 //on
@@ -101,6 +111,12 @@ void SensorBoard_updateDigitalPort (char c) {
   } else {
     int port = (remainData >> 1) & B1111;
     int value = ((remainData & 1) << 7) + (c & B1111111);
+    if(port==REPORT_PERIOD_PORT){
+      if(value==0) value=REPORT_PERIOD_DEFAULT;
+      reportPeriodUs = max(value, REPORT_PERIOD_MIN) * 1000UL;
+      remainData = 0;
+      return;
+    }
     SensorBoard_setPortWritable(port);
     if(port==servoPin){
       servo1.write(value);
@@ -180,9 +196,10 @@ void updateDigitalPort (char c) {
   } else {
     int port = (remainData >> 1) & B1111;
     int value = ((remainData & 1) << 7) + (c & B1111111);
+    remainData = 0;
+    if(port==REPORT_PERIOD_PORT) return; //SensorBoard only
     setPortWritable(port);
     analogWrite(port, value);
-    remainData = 0;
   }
 }
 //diff
@@ -287,9 +304,7 @@ void setup(){
   
   //Common
   Serial.begin(57600);
-  while(1){
-    if (Serial.read()) break;
-  }
+  nextReportUs = nextServoUs = micros();
 }
 
 
@@ -318,16 +333,13 @@ void loop() {
               char c = Serial.read();
               SensorBoard_updateDigitalPort(c);
           } 
-        
-         if(rotation>1000){
-            rotation=0;
-             SensorBoard_sendPinValues();
-       //     Serial.flush();
-			servo1.refresh();
-
-         }
-       
-      rotation++; 
+
+          if(deadlinePassed(nextReportUs, reportPeriodUs)){
+            SensorBoard_sendPinValues();
+          }
+          if(deadlinePassed(nextServoUs, SERVO_REFRESH_US)){
+            servo1.refresh();
+          }
     }
      
 }
@@ -0,0 +1,93 @@
+// Host test: MovingAverage against the re-summing filters it replaced,
+// cal_sound() from entry/entrybt and smoothingValue() from rokoboard.
+// `int` is 16 bits on AVR, so the old code is written with int16_t.
+// Build and run with `make -C test` from the entry directory.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "../MovingAverage.h"
+
+#define SAMPLES 200000L
+
+static uint32_t seed = 1;
+
+// Deterministic ADC reading, 0..1023
+static int16_t analogSample() {
+  seed = seed * 1664525UL + 1013904223UL;
+  return (seed >> 16) & 1023;
+}
+
+// cal_sound() before MovingAverage
+const int16_t M_SIZE = 20;
+int16_t iii = 0;
+int16_t mdata[M_SIZE];
+int16_t sound_offset = 0;
+
+int16_t oldCalSound(int16_t reading) {
+  if (sound_offset == 0) mdata[iii] = reading;
+  else mdata[iii] = sound_offset - reading;
+  iii++;
+  if (iii >= M_SIZE) iii = 0;
+
+  int16_t sensorValue = 0;
+  for (int16_t i = 0; i < M_SIZE; i++) {
+    sensorValue += abs(mdata[i]);
+  }
+  sensorValue = sensorValue / M_SIZE;
+  return sensorValue;
+}
+
+// smoothingValue() before MovingAverage
+const int16_t sensorChannels = 8;
+const int16_t maxNumReadings = 30;
+int16_t smoothingValues[sensorChannels][maxNumReadings];
+int16_t smoothingIndex[sensorChannels];
+int16_t smoothingTotal[sensorChannels];
+
+int16_t oldSmoothingValue(int16_t channel, int16_t value, int16_t numReadings) {
+  int16_t total;
+  int16_t index = smoothingIndex[channel];
+  total = smoothingTotal[channel] - smoothingValues[channel][index];
+  smoothingValues[channel][index] = value;
+  smoothingTotal[channel] = total + value;
+  smoothingIndex[channel]++;
+  if (smoothingIndex[channel] >= numReadings) {
+    smoothingIndex[channel] = 0;
+  }
+  return int16_t(round(smoothingTotal[channel] / (numReadings)));
+}
+
+static int failures = 0;
+
+static void expect(const char *name, long i, int16_t expected, int actual) {
+  if (expected != actual && failures++ < 10)
+    printf("FAIL %s sample %ld: expected %d, got %d\n", name, i, expected, actual);
+}
+
+int main() {
+  // Sound, raw until the offset is calibrated halfway through, as entry does
+  MovingAverage<20, MOVING_AVERAGE_ABSOLUTE> soundAverage;
+  for (long i = 0; i < SAMPLES; i++) {
+    if (i == SAMPLES / 2)
+      sound_offset = 512;
+    int16_t reading = analogSample();
+    int actual = sound_offset == 0 ? soundAverage.add(reading) : soundAverage.add(sound_offset - reading);
+    expect("cal_sound", i, oldCalSound(reading), actual);
+  }
+
+  // The rokoboard windows: sound and light 20, slider 3, resistance 5
+  MovingAverage<20> window20;
+  MovingAverage<3> window3;
+  MovingAverage<5> window5;
+  for (long i = 0; i < SAMPLES; i++) {
+    int16_t a = analogSample(), b = analogSample(), c = analogSample();
+    expect("smoothingValue 20", i, oldSmoothingValue(0, a, 20), window20.add(a));
+    expect("smoothingValue 3", i, oldSmoothingValue(1, b, 3), window3.add(b));
+    expect("smoothingValue 5", i, oldSmoothingValue(2, c, 5), window5.add(c));
+  }
+
+  printf("%s MovingAverage matches cal_sound and smoothingValue over %ld samples\n",
+         failures ? "FAIL" : "ok  ", SAMPLES);
+  return failures != 0;
+}
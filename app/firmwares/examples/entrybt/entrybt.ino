@@ -1,5 +1,6 @@
 #include <SoftwareServo.h>
 #include <SoftwareSerial.h>
+#include "MovingAverage.h"
 
 #define sRX 13
 #define sTX 12
@@ -11,13 +12,18 @@ int servoPin = 6;
 char remainData;
 const int M_SIZE=20;
 const int M_DELAY=100;
-int iii=0;
 int rotation=1000;
 int analogcount=0;
 int DC_ON=0; // if DC motor is use or not use:1, not;0
-int mdata[M_SIZE];
+MovingAverage<M_SIZE, MOVING_AVERAGE_ABSOLUTE> soundAverage;
 int analogValue[6];
 
+//ADC sequencer, A0~A5 converted in the background
+#define ADC_CHANNELS 6
+volatile int adcValue[ADC_CHANNELS];
+volatile uint8_t adcChannel = 0;
+volatile boolean adcDiscard = true;
+
 int sound_offset=0;
 int cds1_offset=0;
 int cds2_offset=0;
@@ -38,26 +44,52 @@ void mydelay_us(unsigned int time_us)
     }
 }
 
+//Only for the calibration in setup(), before the ADC sequencer takes the ADC
 int analogReadPin(int apin){
   analogRead(apin);
   mydelay_us(M_DELAY);
   return analogRead(apin);
 }
 
+//Each channel gets two conversions, the first only lets the S/H settle and is
+//thrown away. A single conversion latches ADMUX on the first ADC clock after
+//ADSC, up to 128 CPU cycles later, so the next channel is always selected
+//before ADSC and the mux is never touched while a conversion may be starting.
+void adcBegin(){
+  adcChannel = 0;
+  adcDiscard = true;
+  ADMUX = _BV(REFS0) | adcChannel; // AVcc reference
+  ADCSRA = _BV(ADEN) | _BV(ADIE) | _BV(ADSC) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0); // 125kHz ADC clock
+}
+
+ISR(ADC_vect){
+  int value = ADC;
+  if(adcDiscard){
+    adcDiscard = false;
+    ADCSRA |= _BV(ADSC); // same channel again, this one is kept
+    return;
+  }
+  adcValue[adcChannel] = value;
+  if(++adcChannel >= ADC_CHANNELS) adcChannel = 0;
+  adcDiscard = true;
+  ADMUX = _BV(REFS0) | adcChannel;
+  ADCSRA |= _BV(ADSC);
+}
+
+//Latest conversion of a channel, never waits
+int adcRead(uint8_t channel){
+  uint8_t oldSREG = SREG;
+  cli();
+  int value = adcValue[channel];
+  SREG = oldSREG;
+  return value;
+}
+
 //Made by Sang Bin Yim 20150423
 int cal_sound(){ //calculate the moving average of the sound input 
-  if(sound_offset==0) { mdata[iii]= analogReadPin(A0);}
-  else{ mdata[iii]= sound_offset-analogReadPin(A0);}
-  iii++;
-  if(iii>=M_SIZE) iii=0;
-  
-  int sensorValue=0;
-  for(int i=0; i<M_SIZE; i++){
-    sensorValue+=abs(mdata[i]); //Moving Average
-  }
-  sensorValue=sensorValue/M_SIZE; 
-  
-  return sensorValue;  
+  int value = (ADCSRA & _BV(ADIE)) ? adcRead(0) : analogReadPin(A0);
+  if(sound_offset==0) return soundAverage.add(value);
+  return soundAverage.add(sound_offset-value);
 }
 
 void cal_offset(){
@@ -158,9 +190,9 @@ void readAnalogValue(int pinNumber) {
   int value=0;  
   
   if(pinNumber==0) value = cal_sound(); //Modified by Sang Bin Yim 20150423
-  else if(pinNumber==1) {value=analogReadPin(pinNumber); value=100+value-cds1_offset;}
-  else if(pinNumber==4) {value=analogReadPin(pinNumber); value=100+value-cds2_offset;}
-  else {value = analogReadPin(pinNumber);}//Modified by Sang Bin Yim 20150423
+  else if(pinNumber==1) {value=adcRead(pinNumber); value=100+value-cds1_offset;}
+  else if(pinNumber==4) {value=adcRead(pinNumber); value=100+value-cds2_offset;}
+  else {value = adcRead(pinNumber);}//Modified by Sang Bin Yim 20150423
   
   analogValue[pinNumber]=value;
 }
@@ -209,6 +241,7 @@ void initPorts () {
 void setup(){
   initPorts();
   cal_offset();
+  adcBegin();
   servo1.attach(servoPin);
  
   SerialB.begin(9600);
@@ -19,6 +19,31 @@
 
 static uint8_t latch_state;
 
+// latch_state is shared with the stepper timer interrupt, so changes to it
+// from the main loop are made with interrupts off.
+#if defined(__AVR__)
+  #define LATCH_LOCK()    uint8_t latchSREG = SREG; cli()
+  #define LATCH_UNLOCK()  SREG = latchSREG
+#else
+  #define LATCH_LOCK()
+  #define LATCH_UNLOCK()
+#endif
+
+#if defined(__AVR_ATmega48__) || \
+    defined(__AVR_ATmega88__) || \
+    defined(__AVR_ATmega168__) || \
+    defined(__AVR_ATmega328P__) || \
+    defined(__AVR_ATmega1280__) || \
+    defined(__AVR_ATmega2560__)
+  #define STEPPER_TIMER1
+  #define STEPPER_TIMER_HZ 2000000UL    // Timer1 at F_CPU/8
+  // Shortest step delay, a little over what one compare interrupt costs
+  // (entry, onestep() with the latch shift, the next schedule). A compare set
+  // closer than that is already behind the timer and waits a whole wrap.
+  #define STEPPER_MIN_COUNTS 200
+  #define STEPPER_LEAD 16               // counts from reading TCNT1 to the compare
+#endif
+
 #if (MICROSTEPS == 8)
 uint8_t microstepcurve[] = {0, 50, 98, 142, 180, 212, 236, 250, 255};
 #elif (MICROSTEPS == 16)
@@ -27,59 +52,93 @@ uint8_t microstepcurve[] = {0, 25, 50, 74, 98, 120, 141, 162, 180, 197, 212, 225
 
 AFMotorController::AFMotorController(void) {
     TimerInitalized = false;
+    latchHold = 0;
+    latchPending = false;
+}
+
+static void latch_shift(void) {
+  uint8_t i;
+  LATCH_LOCK();
+
+#if defined(LATCH_PORT)
+  LATCH_PORT &= ~_BV(LATCH);
+  SER_PORT &= ~_BV(SER);
+
+  for (i=0; i<8; i++) {
+    CLK_PORT &= ~_BV(CLK);
+
+    if (latch_state & _BV(7-i)) {
+      SER_PORT |= _BV(SER);
+    } else {
+      SER_PORT &= ~_BV(SER);
+    }
+    CLK_PORT |= _BV(CLK);
+  }
+  LATCH_PORT |= _BV(LATCH);
+#else
+  digitalWrite(MOTORLATCH, LOW);
+  digitalWrite(MOTORDATA, LOW);
+
+  for (i=0; i<8; i++) {
+    digitalWrite(MOTORCLK, LOW);
+
+    if (latch_state & _BV(7-i)) {
+      digitalWrite(MOTORDATA, HIGH);
+    } else {
+      digitalWrite(MOTORDATA, LOW);
+    }
+    digitalWrite(MOTORCLK, HIGH);
+  }
+  digitalWrite(MOTORLATCH, HIGH);
+#endif
+  LATCH_UNLOCK();
 }
 
 void AFMotorController::enable(void) {
   // setup the latch
-  /*
-  LATCH_DDR |= _BV(LATCH);
-  ENABLE_DDR |= _BV(ENABLE);
-  CLK_DDR |= _BV(CLK);
-  SER_DDR |= _BV(SER);
-  */
   pinMode(MOTORLATCH, OUTPUT);
   pinMode(MOTORENABLE, OUTPUT);
   pinMode(MOTORDATA, OUTPUT);
   pinMode(MOTORCLK, OUTPUT);
 
+  LATCH_LOCK();
   latch_state = 0;
 
-  latch_tx();  // "reset"
+  latch_shift();  // "reset", even while the latch is held
+  latchPending = false;
+  LATCH_UNLOCK();
 
-  //ENABLE_PORT &= ~_BV(ENABLE); // enable the chip outputs!
   digitalWrite(MOTORENABLE, LOW);
 }
 
 
 void AFMotorController::latch_tx(void) {
-  uint8_t i;
+  if (latchHold) {
+    latchPending = true;
+    return;
+  }
+  latch_shift();
+}
 
-  //LATCH_PORT &= ~_BV(LATCH);
-  digitalWrite(MOTORLATCH, LOW);
+static AFMotorController MC;
 
-  //SER_PORT &= ~_BV(SER);
-  digitalWrite(MOTORDATA, LOW);
+uint8_t getlatchstate(void) {
+  return latch_state;
+}
 
-  for (i=0; i<8; i++) {
-    //CLK_PORT &= ~_BV(CLK);
-    digitalWrite(MOTORCLK, LOW);
+void holdlatch(void) {
+  MC.latchHold++;
+}
 
-    if (latch_state & _BV(7-i)) {
-      //SER_PORT |= _BV(SER);
-      digitalWrite(MOTORDATA, HIGH);
-    } else {
-      //SER_PORT &= ~_BV(SER);
-      digitalWrite(MOTORDATA, LOW);
-    }
-    //CLK_PORT |= _BV(CLK);
-    digitalWrite(MOTORCLK, HIGH);
+void releaselatch(void) {
+  LATCH_LOCK();
+  if (MC.latchHold && !--MC.latchHold && MC.latchPending) {
+    MC.latchPending = false;
+    latch_shift();
   }
-  //LATCH_PORT |= _BV(LATCH);
-  digitalWrite(MOTORLATCH, HIGH);
+  LATCH_UNLOCK();
 }
 
-static AFMotorController MC;
-
 /******************************************
                MOTORS
 ******************************************/
@@ -368,6 +427,7 @@ AF_DCMotor::AF_DCMotor(uint8_t num, uint8_t freq) {
 void AF_DCMotor::ready() {
   MC.enable();
 
+  LATCH_LOCK();
   switch (motornum) {
   case 1:
     latch_state &= ~_BV(MOTOR1_A) & ~_BV(MOTOR1_B); // set both motor pins to 0
@@ -389,7 +449,8 @@ void AF_DCMotor::ready() {
     MC.latch_tx();
     initPWM4(pwmfreq);
     break;
-  }	
+  }
+  LATCH_UNLOCK();
 }
 
 void AF_DCMotor::run(uint8_t cmd) {
@@ -407,6 +468,7 @@ void AF_DCMotor::run(uint8_t cmd) {
     return;
   }
   
+  LATCH_LOCK();
   switch (cmd) {
   case FORWARD:
     latch_state |= _BV(a);
@@ -424,6 +486,7 @@ void AF_DCMotor::run(uint8_t cmd) {
     MC.latch_tx();
     break;
   }
+  LATCH_UNLOCK();
 }
 
 void AF_DCMotor::setSpeed(uint8_t speed) {
@@ -449,6 +512,11 @@ AF_Stepper::AF_Stepper(uint16_t steps, uint8_t num) {
   revsteps = steps;
   steppernum = num;
   currentstep = 0;
+  usperstep = 0;
+  movehead = movetail = 0;
+  stepsleft = waitleft = 0;
+  stepstotal = 0;
+  acceleration = 0;
 /*
   if (steppernum == 1) {
     latch_state &= ~_BV(MOTOR1_A) & ~_BV(MOTOR1_B) &
@@ -492,9 +560,11 @@ void AF_Stepper::ready() {
 	MC.enable();
 	
 	if (steppernum == 1) {
+    LATCH_LOCK();
     latch_state &= ~_BV(MOTOR1_A) & ~_BV(MOTOR1_B) &
       ~_BV(MOTOR2_A) & ~_BV(MOTOR2_B); // all motor pins to 0
     MC.latch_tx();
+    LATCH_UNLOCK();
     
     // enable both H bridges
     pinMode(11, OUTPUT);
@@ -509,9 +579,11 @@ void AF_Stepper::ready() {
     setPWM2(255);
 
   } else if (steppernum == 2) {
+    LATCH_LOCK();
     latch_state &= ~_BV(MOTOR3_A) & ~_BV(MOTOR3_B) &
       ~_BV(MOTOR4_A) & ~_BV(MOTOR4_B); // all motor pins to 0
     MC.latch_tx();
+    LATCH_UNLOCK();
 
     // enable both H bridges
     pinMode(5, OUTPUT);
@@ -534,6 +606,7 @@ void AF_Stepper::setSpeed(uint16_t rpm) {
 }
 
 void AF_Stepper::release(void) {
+  LATCH_LOCK();
   if (steppernum == 1) {
     latch_state &= ~_BV(MOTOR1_A) & ~_BV(MOTOR1_B) &
       ~_BV(MOTOR2_A) & ~_BV(MOTOR2_B); // all motor pins to 0
@@ -543,6 +616,7 @@ void AF_Stepper::release(void) {
       ~_BV(MOTOR4_A) & ~_BV(MOTOR4_B); // all motor pins to 0
     MC.latch_tx();
   }
+  LATCH_UNLOCK();
 }
 
 void AF_Stepper::step(uint16_t steps, uint8_t dir,  uint8_t style) {
@@ -687,6 +761,7 @@ uint8_t AF_Stepper::onestep(uint8_t dir, uint8_t style) {
 
 
   // release all
+  LATCH_LOCK();
   latch_state &= ~a & ~b & ~c & ~d; // all motor pins to 0
 
   //Serial.println(step, DEC);
@@ -730,6 +805,214 @@ uint8_t AF_Stepper::onestep(uint8_t dir, uint8_t style) {
 
  
   MC.latch_tx();
+  LATCH_UNLOCK();
   return currentstep;
 }
 
+/******************************************
+           BACKGROUND STEPPING
+******************************************/
+
+#if defined(STEPPER_TIMER1)
+static AF_Stepper * volatile timerstepper[2];
+
+static void timer1_init(void) {
+  // free running Timer1, 0.5us per count; this takes pins 9/10 off PWM
+  TCCR1A = 0;
+  TCCR1B = _BV(CS11);
+}
+
+ISR(TIMER1_COMPA_vect) {
+  if (timerstepper[0])
+    timerstepper[0]->service();
+}
+
+ISR(TIMER1_COMPB_vect) {
+  if (timerstepper[1])
+    timerstepper[1]->service();
+}
+#endif
+
+void AF_Stepper::setAcceleration(uint16_t accel) {
+  uint32_t c0 = 0;
+
+#if defined(STEPPER_TIMER1)
+  // AVR446 first step delay, c0 = 0.676 * f * sqrt(2 / accel); the only float
+  // math, done here so the interrupt works in integers
+  if (accel)
+    c0 = 0.676 * STEPPER_TIMER_HZ * sqrt(2.0 / accel);
+#endif
+
+  LATCH_LOCK();
+  acceleration = accel;
+  startdelay = c0;
+  LATCH_UNLOCK();
+}
+
+bool AF_Stepper::queue(uint16_t steps, uint8_t dir, uint8_t style) {
+#if defined(STEPPER_TIMER1)
+  if (!steps || (steppernum != 1 && steppernum != 2))
+    return false;
+
+  uint8_t next = (movehead + 1) % STEPPER_QUEUE;
+  if (next == movetail)
+    return false;   // queue full
+  moves[movehead].steps = steps;
+  moves[movehead].dir = dir;
+  moves[movehead].style = style;
+
+  LATCH_LOCK();
+  movehead = next;
+  uint8_t ocie = steppernum == 1 ? _BV(OCIE1A) : _BV(OCIE1B);
+  if (!(TIMSK1 & ocie)) {
+    if (!timerstepper[0] && !timerstepper[1])
+      timer1_init();
+    timerstepper[steppernum - 1] = this;
+    waitleft = 0;
+    if (steppernum == 1) {
+      OCR1A = TCNT1 + STEPPER_LEAD;
+      TIFR1 = _BV(OCF1A);
+    } else {
+      OCR1B = TCNT1 + STEPPER_LEAD;
+      TIFR1 = _BV(OCF1B);
+    }
+    TIMSK1 |= ocie;
+  }
+  LATCH_UNLOCK();
+  return true;
+#else
+  step(steps, dir, style);
+  return true;
+#endif
+}
+
+void AF_Stepper::stop(void) {
+  LATCH_LOCK();
+  movetail = movehead;
+  stepsleft = waitleft = 0;
+#if defined(STEPPER_TIMER1)
+  TIMSK1 &= steppernum == 1 ? ~_BV(OCIE1A) : ~_BV(OCIE1B);
+#endif
+  LATCH_UNLOCK();
+}
+
+bool AF_Stepper::running(void) {
+  LATCH_LOCK();
+  bool busy = stepsleft || movehead != movetail;
+  LATCH_UNLOCK();
+  return busy;
+}
+
+uint8_t AF_Stepper::progress(void) {
+  LATCH_LOCK();
+  uint32_t left = stepsleft, total = stepstotal;
+  LATCH_UNLOCK();
+  if (!left || !total)
+    return 100;
+  return (total - left) * 100 / total;
+}
+
+#if defined(STEPPER_TIMER1)
+// Take the next queued move and work out its speed profile.
+bool AF_Stepper::nextmove(void) {
+  if (movehead == movetail)
+    return false;
+
+  move_t *m = &moves[movetail];
+  uint32_t uspers = usperstep;
+  uint32_t steps = m->steps;
+
+  movedir = m->dir;
+  movestyle = m->style;
+  movetail = (movetail + 1) % STEPPER_QUEUE;
+
+  if (movestyle == INTERLEAVE) {
+    uspers /= 2;
+  } else if (movestyle == MICROSTEP) {
+    uspers /= MICROSTEPS;
+    steps *= MICROSTEPS;
+  }
+
+  mindelay = uspers * (STEPPER_TIMER_HZ / 1000000UL);
+  if (mindelay < STEPPER_MIN_COUNTS)
+    mindelay = STEPPER_MIN_COUNTS;
+  stepstotal = stepsleft = steps;
+  rampn = rampremainder = 0;
+
+  if (acceleration && startdelay > mindelay) {
+    // steps to reach full speed: v^2 / (2 * accel), at most half the move
+    uint32_t v = STEPPER_TIMER_HZ / mindelay;
+    if (v > 0xFFFF)
+      v = 0xFFFF;
+    rampsteps = v * v / (2UL * acceleration);
+    if (rampsteps > steps / 2)
+      rampsteps = steps / 2;
+    stepdelay = startdelay;
+  } else {
+    rampsteps = 0;
+    stepdelay = mindelay;
+  }
+  return true;
+}
+
+// Sets the next compare relative to the last one. A wait over one timer period
+// is taken a period at a time and the last two parts are halves, so no part is
+// shorter than the interrupt that sets it.
+void AF_Stepper::schedule(uint32_t counts) {
+  if (counts > 0xFFFF) {
+    uint32_t part = counts > 2 * 0xFFFFUL ? 0xFFFF : counts / 2;
+    waitleft = counts - part;
+    counts = part;
+  } else {
+    waitleft = 0;
+  }
+  volatile uint16_t &ocr = steppernum == 1 ? OCR1A : OCR1B;
+  // late if another interrupt held this one off
+  uint16_t late = TCNT1 - ocr;
+  if (counts < (uint32_t)late + STEPPER_LEAD)
+    counts = late + STEPPER_LEAD;
+  ocr += (uint16_t)counts;
+}
+
+// One timer compare: finish a long wait, or take a step and set up the next
+// delay with the AVR446 recurrence c' = c -/+ (2c + r) / (4n +/- 1).
+void AF_Stepper::service(void) {
+  if (waitleft) {
+    schedule(waitleft);
+    return;
+  }
+  if (!stepsleft && !nextmove()) {
+    TIMSK1 &= steppernum == 1 ? ~_BV(OCIE1A) : ~_BV(OCIE1B);
+    return;
+  }
+
+  // a step must not wait for the main loop's releaselatch()
+  uint8_t hold = MC.latchHold;
+  MC.latchHold = 0;
+  onestep(movedir, movestyle);
+  MC.latchHold = hold;
+
+  uint32_t counts = stepdelay;
+  uint32_t done = stepstotal - --stepsleft;
+
+  if (rampsteps && done < rampsteps) {
+    int32_t num = 2 * (int32_t)stepdelay + rampremainder;
+    int32_t den = 4 * ++rampn + 1;
+    stepdelay -= num / den;
+    rampremainder = num % den;
+    if (stepdelay < mindelay)
+      stepdelay = mindelay;
+  } else if (rampsteps && stepsleft && stepsleft <= rampsteps) {
+    if (stepsleft == rampsteps)
+      rampremainder = 0;
+    int32_t num = 2 * (int32_t)stepdelay + rampremainder;
+    int32_t den = 4 * (int32_t)stepsleft - 1;
+    stepdelay += num / den;
+    rampremainder = num % den;
+  } else if (stepsleft) {
+    stepdelay = mindelay;
+  }
+  schedule(counts);
+}
+#endif
+
@@ -117,23 +117,32 @@
 #define INTERLEAVE 3
 #define MICROSTEP 4
 
-/*
-#define LATCH 4
-#define LATCH_DDR DDRB
-#define LATCH_PORT PORTB
-
-#define CLK_PORT PORTD
-#define CLK_DDR DDRD
-#define CLK 4
-
-#define ENABLE_PORT PORTD
-#define ENABLE_DDR DDRD
-#define ENABLE 7
-
-#define SER 0
-#define SER_DDR DDRB
-#define SER_PORT PORTB
-*/
+// Moves an AF_Stepper can hold for queue()
+#define STEPPER_QUEUE 4
+
+#if defined(__AVR_ATmega8__) || \
+    defined(__AVR_ATmega48__) || \
+    defined(__AVR_ATmega88__) || \
+    defined(__AVR_ATmega168__) || \
+    defined(__AVR_ATmega328P__)
+    // Port bits of the latch pins below, so latch_tx() can write the ports
+    // directly instead of going through digitalWrite()
+    #define LATCH 4
+    #define LATCH_DDR DDRB
+    #define LATCH_PORT PORTB
+
+    #define CLK_PORT PORTD
+    #define CLK_DDR DDRD
+    #define CLK 4
+
+    #define ENABLE_PORT PORTD
+    #define ENABLE_DDR DDRD
+    #define ENABLE 7
+
+    #define SER 0
+    #define SER_DDR DDRB
+    #define SER_PORT PORTB
+#endif
 
 // Arduino pin names for interface to 74HCT595 latch
 #define MOTORLATCH 12
@@ -149,6 +158,7 @@ class AFMotorController
     friend class AF_DCMotor;
     void latch_tx(void);
     uint8_t TimerInitalized;
+    uint8_t latchHold, latchPending;
 };
 
 class AF_DCMotor
@@ -174,11 +184,40 @@ class AF_Stepper {
   uint16_t revsteps; // # steps per revolution
   uint8_t steppernum;
   uint32_t usperstep, steppingcounter;
+
+  // Background moves: queue() returns at once and the steps are generated
+  // from the Timer1 compare interrupt (OCR1A for stepper 1, OCR1B for 2),
+  // ramping up and down at setAcceleration() steps/s^2 (0 = no ramp). On
+  // chips without that timer code (ATmega8, 32U4, PIC32) queue() steps in
+  // place like step() and there is no ramp.
+  void setAcceleration(uint16_t accel);
+  bool queue(uint16_t steps, uint8_t dir, uint8_t style = SINGLE);
+  void stop(void);
+  bool running(void);
+  uint8_t progress(void);  // % of the current move done, 100 when idle
+  void service(void);      // called from the timer interrupt (Timer1 chips only)
+
  private:
   uint8_t currentstep;
 
+  struct move_t { uint16_t steps; uint8_t dir, style; };
+  move_t moves[STEPPER_QUEUE];
+  volatile uint8_t movehead, movetail;
+  volatile uint32_t stepsleft, waitleft;
+  uint32_t stepstotal, rampsteps;
+  uint32_t stepdelay, mindelay, startdelay;
+  int32_t rampn, rampremainder;
+  uint16_t acceleration;
+  uint8_t movedir, movestyle;
+  bool nextmove(void);
+  void schedule(uint32_t counts);
 };
 
 uint8_t getlatchstate(void);
 
+// Defer latch updates between holdlatch() and releaselatch(), so several
+// run()/onestep() calls in one loop pass go out to the 74HC595 as one write.
+void holdlatch(void);
+void releaselatch(void);
+
 #endif
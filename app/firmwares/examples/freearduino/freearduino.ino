@@ -5,10 +5,22 @@
 #include"AnalogReadFast.h"
 
 #define USE_SOFTWARESERIAL      1
+#define USE_SAMPLE_BENCHMARK    0   // report collectData() time (us) as sensor value 13
+#define USE_TIMESTAMP           1   // prefix each frame with its sample time, sensor values 19 + 14
+
+#define SENSORVALUE_SAMPLE_US   13
+#define SENSORVALUE_STAMP_LOW   14  // low 10 bits of the delta
+#define SENSORVALUE_STAMP_HIGH  19  // high 6 bits, sent first
+
+#define BT_BAUD_SLOW 9600      // HC-05/06 factory default
+#define BT_BAUD_FAST 38400     // fastest rate NeoSWSerial supports at 16MHz
+#define BT_AT_TIMEOUT 300      // wait for "OK" from the module
 
 #define SENSORVALUE_US_DIST     12
 #define SENSORVALUE_DHT_HUMI    15
 #define SENSORVALUE_DHT_TEMP    16
+#define SENSORVALUE_STEPPER1    17
+#define SENSORVALUE_STEPPER2    18
 
 #define STATE_OFF 0
 #define STATE_WAIT 1
@@ -22,19 +34,27 @@
 #define US_DELAY 50      // wait for read ultrasonic sensor
 #define SERVO_REFRESH_DELAY 50 // wait for SoftwareServo refresh call
 
+#define STEPPER_STEPS 200   // steps per revolution
+#define STEPPER_RPM 60      // default speed
+#define STEPPER_ACCEL 400   // steps/s^2
+
+#define STAMP_MAX 0xFFFF    // delta in 4us units, saturates after 262ms
+
 NeoSWSerial *bSerial;
 
 char remainData;
 int pinState[20] = {STATE_OFF};
-int digitalReadValue[14] = {0};
 int analogReadValue[6] = {0};
-int digitalReadValue2[14] = {0};
 int analogReadValue2[6] = {0};
 char digitalEncoded[4] = {0};
 int sendPhase = 1;
+bool btFast = false;
 int pwm[6] = {3, 5, 6, 9, 10, 11};
 unsigned long sendTimer = 0;
 unsigned long readTimer = 0;
+unsigned int sampleMicros = 0;
+unsigned long sampledAt = 0;
+unsigned long lastStamp = 0;
 
 AF_DCMotor motor[4] = {AF_DCMotor(1), AF_DCMotor(2), AF_DCMotor(3), AF_DCMotor(4)};
 int motorPin[4] = {11, 3, 5, 6};
@@ -42,6 +62,16 @@ int motorSpeed[4] = {200, 200, 200, 200};
 unsigned long motorLastUsed[5];
 bool motorFlag = false;
 
+// Stepper 1 runs on M1/M2, stepper 2 on M3/M4. Moves are queued and stepped
+// from Timer1 in the background. Port 31/32 stage the step count (low/high
+// byte), 34/35 set the rpm, and port 33 starts a move when its value changes:
+// bit0 stepper, bit1 backward, bit2-3 style-1, bit4 stop, bit7 toggles.
+AF_Stepper stepper[2] = {AF_Stepper(STEPPER_STEPS, 1), AF_Stepper(STEPPER_STEPS, 2)};
+unsigned int stepperSteps = 0;
+int stepperCommand = -1;
+bool stepperReady[2] = {false, false};
+bool stepperFlag = false;
+
 SoftwareServo servo[SERVO_MAX];
 int servoPin[SERVO_MAX] = {0};
 int servoValue[SERVO_MAX] = {0};
@@ -66,12 +96,17 @@ bool usFlag = false;
 void setup() {
   if (USE_SOFTWARESERIAL) {
     bSerial = new NeoSWSerial(A4, A5);
-    bSerial->begin(9600);
+    bSerial->begin(BT_BAUD_SLOW);
+    btFast = negotiateBaud();
   }
   else {
     Serial.begin(9600);
     Serial.flush();
   }
+  for (int i = 0; i < 2; i++) {
+    stepper[i].setSpeed(STEPPER_RPM);
+    stepper[i].setAcceleration(STEPPER_ACCEL);
+  }
   initPin();
   delay(100);
 }
@@ -84,6 +119,7 @@ void initPin() {
 }
 
 void loop() {
+  holdlatch();    // motor commands of this pass go out in one latch write
   if (USE_SOFTWARESERIAL) {
     while (bSerial->available()) {
       if (bSerial->available() > 0) {
@@ -100,6 +136,7 @@ void loop() {
       }
     }
   }
+  releaselatch();
 
   if (motorFlag) {
     if (pinState[motorPin[0]] >= STATE_RUN && millis() - motorLastUsed[0] >= WAIT_DELAY) {
@@ -120,6 +157,13 @@ void loop() {
     }
   }
 
+  if (stepperFlag) {
+    for (int i = 0; i < 2; i++) {
+      if (stepper[i].running())   // keep the motor pins locked while moving
+        motorLastUsed[i * 2] = motorLastUsed[i * 2 + 1] = motorLastUsed[4] = millis();
+    }
+  }
+
   if (servoFlag) {
     if (millis() - servoLastUsed >= WAIT_DELAY)
       detachServo();
@@ -159,17 +203,62 @@ void loop() {
 
   if (millis() - sendTimer >= SEND_DELAY) {
     sendTimer = millis();
-    collectData();
-    if (USE_SOFTWARESERIAL) {
+    sampledAt = micros();
+    if (USE_SAMPLE_BENCHMARK) {
+      unsigned long sampleStart = micros();
+      collectData();
+      sampleMicros = micros() - sampleStart;
+    }
+    else {
+      collectData();
+    }
+    if (USE_SOFTWARESERIAL && !btFast) {
       sendData(sendPhase++);
       if(sendPhase>3) sendPhase = 1;
     }
     else {
-      sendData(1);
-      sendData(2);
-      sendData(3);
+      sendSnapshot();
+    }
+  }
+}
+
+// Switch the Bluetooth module to BT_BAUD_FAST while it is not paired yet.
+// HC-06 accepts AT commands in this state; a module that was already switched
+// answers at the fast rate. HC-05 only takes AT commands in key mode, so it
+// stays at 9600 unless it was set to 38400 beforehand (AT+UART=38400,0,0).
+bool negotiateBaud() {
+  bSerial->setBaudRate(BT_BAUD_FAST);
+  if (sendATCommand("AT", "OK"))
+    return true;
+  bSerial->setBaudRate(BT_BAUD_SLOW);
+  if (sendATCommand("AT", "OK") && sendATCommand("AT+BAUD6", "OK")) {
+    bSerial->setBaudRate(BT_BAUD_FAST);
+    if (sendATCommand("AT", "OK"))
+      return true;
+  }
+  bSerial->setBaudRate(BT_BAUD_SLOW);
+  return false;
+}
+
+bool sendATCommand(const char *command, const char *reply) {
+  while (bSerial->available())
+    bSerial->read();
+  bSerial->print(command);
+
+  const char *expect = reply;
+  unsigned long start = millis();
+  while (millis() - start < BT_AT_TIMEOUT) {
+    if (bSerial->available()) {
+      char c = bSerial->read();
+      if (c == *expect) {
+        if (!*++expect)
+          return true;
+      }
+      else
+        expect = reply;
     }
   }
+  return false;
 }
 
 void updateData (char c) {
@@ -267,6 +356,19 @@ void updateData (char c) {
         motorLastUsed[number] = motorLastUsed[4] = millis();
       }
     }
+    if (port >= 31 && port <= 35) {
+      int value = ((remainData & 1) << 7) | c;
+      if (port == 31)
+        stepperSteps = (stepperSteps & 0xFF00) | value;
+      else if (port == 32)
+        stepperSteps = (stepperSteps & 0x00FF) | (value << 8);
+      else if (port == 33 && value != stepperCommand) {
+        stepperCommand = value;
+        runStepper(value);
+      }
+      else if (port >= 34)
+        stepper[port - 34].setSpeed(value ? value : 1);
+    }
     remainData = 0;
   }
   else if (c>>7)
@@ -275,68 +377,137 @@ void updateData (char c) {
     remainData = 0;
 }
 
+void runStepper(int command) {
+  int number = command & 1;
+  AF_Stepper *s = &stepper[number];
+
+  if (command & B10000) {
+    s->stop();
+    s->release();
+    return;
+  }
+  if (!motorFlag) {
+    motorFlag = true;
+    pinState[4] = pinState[7] = pinState[8] = pinState[12] = STATE_LOCK;
+  }
+  if (!stepperReady[number]) {
+    s->ready();
+    stepperReady[number] = true;
+    stepperFlag = true;
+  }
+  s->queue(stepperSteps, command & B10 ? BACKWARD : FORWARD, ((command >> 2) & B11) + 1);
+  pinState[motorPin[number * 2]] = pinState[motorPin[number * 2 + 1]] = STATE_RUN;
+  motorLastUsed[number * 2] = motorLastUsed[number * 2 + 1] = motorLastUsed[4] = millis();
+}
+
 void sendData(int phase) {
+  char buf[24];
+  int len = 0;
+
+  if (USE_TIMESTAMP)
+    len += encodeStamp(buf + len);
+
   if (phase == 1) {
-    sendDigitalValues();
+    len += encodeDigitalValues(buf + len);
     if (dhtFlag) {
-      sendSensorValue(SENSORVALUE_DHT_TEMP, (int)DHT.temperature);
-      sendSensorValue(SENSORVALUE_DHT_HUMI, (int)DHT.humidity);
+      len += encodeSensorValue(buf + len, SENSORVALUE_DHT_TEMP, (int)DHT.temperature);
+      len += encodeSensorValue(buf + len, SENSORVALUE_DHT_HUMI, (int)DHT.humidity);
     }
     if (usFlag)
-      sendSensorValue(SENSORVALUE_US_DIST, (int)distance);
+      len += encodeSensorValue(buf + len, SENSORVALUE_US_DIST, (int)distance);
+    if (USE_SAMPLE_BENCHMARK)
+      len += encodeSensorValue(buf + len, SENSORVALUE_SAMPLE_US, min(sampleMicros, 1023));
+    len += encodeStepperValues(buf + len);
   }
-  if (phase == 2) {
+  if (phase == 2 || phase == 3) {
     for (int pinNumber = 14; pinNumber < 20; pinNumber++) {
-      sendAnalogValue(pinNumber, 0);
+      len += encodeAnalogValue(buf + len, pinNumber, phase == 3);
     }
   }
-  if (phase == 3) {
-    for (int pinNumber = 14; pinNumber < 20; pinNumber++) {
-      sendAnalogValue(pinNumber, 1);
-    }
+  writeBytes(buf, len);
+}
+
+// All three phases of sendData() packed into one frame and written in one go.
+void sendSnapshot() {
+  char buf[48];
+  int len = 0;
+
+  if (USE_TIMESTAMP)
+    len += encodeStamp(buf + len);
+
+  len += encodeDigitalValues(buf + len);
+  for (int pinNumber = 14; pinNumber < 20; pinNumber++) {
+    len += encodeAnalogValue(buf + len, pinNumber, 0);
+  }
+  for (int pinNumber = 14; pinNumber < 20; pinNumber++) {
+    len += encodeAnalogValue(buf + len, pinNumber, 1);
+  }
+  if (dhtFlag) {
+    len += encodeSensorValue(buf + len, SENSORVALUE_DHT_TEMP, (int)DHT.temperature);
+    len += encodeSensorValue(buf + len, SENSORVALUE_DHT_HUMI, (int)DHT.humidity);
   }
+  if (usFlag)
+    len += encodeSensorValue(buf + len, SENSORVALUE_US_DIST, (int)distance);
+  if (USE_SAMPLE_BENCHMARK)
+    len += encodeSensorValue(buf + len, SENSORVALUE_SAMPLE_US, min(sampleMicros, 1023));
+  len += encodeStepperValues(buf + len);
+  writeBytes(buf, len);
+}
+
+// Readable pins of one port (bit n = port pin n): not locked by a device and not an output.
+byte readableMask(int firstPin, int count, byte ddr) {
+  byte mask = 0;
+  for (int i = 0; i < count; i++) {
+    if (pinState[firstPin + i] < STATE_RUN)
+      mask |= 1 << i;
+  }
+  return mask & ~ddr;
+}
+
+// Sample every readable pin of a port twice, floating and with pull-ups, by
+// flipping the PORTx bits for the whole port at once instead of pin by pin.
+void samplePort(volatile uint8_t *port, volatile uint8_t *pin, byte mask, byte *low, byte *high) {
+  uint8_t oldSREG = SREG;
+  cli();
+  *low = *pin & mask;
+  *port |= mask;
+  SREG = oldSREG;
+  delayMicroseconds(5);   // let the pull-ups charge the pin capacitance
+  *high = *pin & mask;
+  cli();
+  *port &= ~mask;
+  SREG = oldSREG;
 }
 
 void collectData() {
-  for (int i=0; i<4; i++) {
-    digitalEncoded[i] = 0;
+  byte maskD = readableMask(2, 6, DDRD >> 2) << 2;   // pins 2-7 = PD2-PD7
+  byte maskB = readableMask(8, 6, DDRB);             // pins 8-13 = PB0-PB5
+  byte maskC = readableMask(14, 6, DDRC);            // pins 14-19 = PC0-PC5
+  byte lowD, highD, lowB, highB;
+
+  samplePort(&PORTD, &PIND, maskD, &lowD, &highD);
+  samplePort(&PORTB, &PINB, maskB, &lowB, &highB);
+  digitalEncoded[0] = lowD >> 2;
+  digitalEncoded[1] = highD >> 2;
+  digitalEncoded[2] = lowB;
+  digitalEncoded[3] = highB;
+
+  for (int i = 0; i < 6; i++) {
+    analogReadValue[i] = (maskC >> i) & 1 ? analogReadFast(i + 14) : 0;
   }
-  for (int i = 2; i < 14; i++) {
-    if (pinState[i] >= STATE_RUN || isPortWritable(i)) {
-      digitalReadValue[i] = 0;
-      digitalReadValue2[i] = 0;
-    }
-    else {
-      digitalReadValue[i] = digitalRead(i);
-      pinMode(i, INPUT_PULLUP);
-      digitalReadValue2[i] = digitalRead(i);
-      pinMode(i, INPUT);
-    }
-    if (i < 8) {
-      digitalEncoded[0] |= (digitalReadValue[i] & 1) << (i - 2);
-      digitalEncoded[1] |= (digitalReadValue2[i] & 1) << (i - 2);
-    }
-    else {
-      digitalEncoded[2] |= (digitalReadValue[i] & 1) << (i - 8);
-      digitalEncoded[3] |= (digitalReadValue2[i] & 1) << (i - 8);
-    }  
-  }
-  for (int i = 14; i < 20; i++) {
-    if (pinState[i] >= STATE_RUN || isPortWritable(i)) {
-      analogReadValue[i - 14] = 0;
-      analogReadValue2[i - 14] = 0;
-    }
-    else {
-      analogReadValue[i - 14] = analogReadFast(i);
-      pinMode(i, INPUT_PULLUP);
-      analogReadValue2[i] = analogReadFast(i);
-      pinMode(i, INPUT);
-    }
+  uint8_t oldSREG = SREG;
+  cli();
+  PORTC |= maskC;
+  SREG = oldSREG;
+  for (int i = 0; i < 6; i++) {
+    analogReadValue2[i] = (maskC >> i) & 1 ? analogReadFast(i + 14) : 0;
   }
+  cli();
+  PORTC &= ~maskC;
+  SREG = oldSREG;
 }
 
-void sendDigitalValues() {
-  char buf[8] = {0};
+int encodeDigitalValues(char *buf) {
   buf[0] = B11111110;
   buf[1] = B00000000 | digitalEncoded[0];
   buf[2] = B11111110;
@@ -345,69 +516,70 @@ void sendDigitalValues() {
   buf[5] = B00000000 | digitalEncoded[2];
   buf[6] = B11111111;
   buf[7] = B01000000 | digitalEncoded[3];
-  if (USE_SOFTWARESERIAL) {
-    bSerial->write(buf[0]);
-    bSerial->write(buf[1]);
-    bSerial->write(buf[2]);
-    bSerial->write(buf[3]);
-    bSerial->write(buf[4]);
-    bSerial->write(buf[5]);
-    bSerial->write(buf[6]);
-    bSerial->write(buf[7]);
-  }
-  else {
-    Serial.write(buf[0]);
-    Serial.write(buf[1]);
-    Serial.write(buf[2]);
-    Serial.write(buf[3]);
-    Serial.write(buf[4]);
-    Serial.write(buf[5]);
-    Serial.write(buf[6]);
-    Serial.write(buf[7]);
-  }
+  return 8;
 }
 
-void sendAnalogValue(int pinNumber, int pullup) {
-  char buf[2] = {0};
+int encodeAnalogValue(char *buf, int pinNumber, int pullup) {
   int value;
+  int index = pinNumber - 14;
 
   if (!pullup) {
-    value = analogReadValue[pinNumber - 14];
+    value = analogReadValue[index];
   }
   else {
-    pinNumber+=6;
-    value = analogReadValue2[pinNumber - 14];
+    value = analogReadValue2[index];
+    index += 6;
   }
 
-  buf[0] = B10000000 | ((pinNumber - 14 & B1111) << 3) | ((value >> 7) & B111);
+  buf[0] = B10000000 | ((index & B1111) << 3) | ((value >> 7) & B111);
   buf[1] = value & B01111111;
-
-  if (USE_SOFTWARESERIAL) {
-    bSerial->write(buf[0]);
-    bSerial->write(buf[1]);
-  }
-  else {
-    Serial.write(buf[0]);
-    Serial.write(buf[1]);
-  }
+  return 2;
 }
 
-void sendSensorValue(int sensor, int value) {
-  char buf[2] = {0};
-
+int encodeSensorValue(char *buf, int sensor, int value) {
   if (sensor < 15)
     buf[0] = B10000000 | ((sensor & B1111) << 3) | (value >> 7 & B111);
   else
     buf[0] = B11111000 | (sensor - 15 & B111);
   buf[1] = B00000000 | (value & B01111111);
-  if (USE_SOFTWARESERIAL) {
-    bSerial->write(buf[0]);
-    bSerial->write(buf[1]);
-  }
-  else {
-    Serial.write(buf[0]);
-    Serial.write(buf[1]);
+  return 2;
+}
+
+// Time of collectData() as the delta to the previous frame, in 4us units.
+// STAMP_MAX means the frames were 262ms or more apart.
+int encodeStamp(char *buf) {
+  unsigned long delta = (sampledAt - lastStamp) >> 2;
+  if (delta >= STAMP_MAX) {
+    delta = STAMP_MAX;
+    lastStamp = sampledAt;
   }
+  else
+    lastStamp += delta << 2;
+
+  int len = encodeSensorValue(buf, SENSORVALUE_STAMP_HIGH, delta >> 10);
+  return len + encodeSensorValue(buf + len, SENSORVALUE_STAMP_LOW, delta & 1023);
+}
+
+// Progress of the current move in %, once a stepper has been used.
+int encodeStepperValues(char *buf) {
+  int len = 0;
+  if (stepperReady[0])
+    len += encodeSensorValue(buf + len, SENSORVALUE_STEPPER1, stepper[0].progress());
+  if (stepperReady[1])
+    len += encodeSensorValue(buf + len, SENSORVALUE_STEPPER2, stepper[1].progress());
+  return len;
+}
+
+void sendSensorValue(int sensor, int value) {
+  char buf[2];
+  writeBytes(buf, encodeSensorValue(buf, sensor, value));
+}
+
+void writeBytes(const char *buf, int len) {
+  if (USE_SOFTWARESERIAL)
+    bSerial->write((const uint8_t *)buf, len);
+  else
+    Serial.write((const uint8_t *)buf, len);
 }
 
 void setPortReadable (int port) {
@@ -0,0 +1,95 @@
+#ifndef QuadratureEncoder_h
+#define QuadratureEncoder_h
+
+#include <Arduino.h>
+
+// x4 quadrature decoder for one encoder on two pins. update() runs in the
+// pin-change interrupt and steps a Gray-code table on every edge of either
+// channel. Input registers and masks are cached by begin(), so an update costs
+// two port reads and a table lookup. A step where both channels changed at
+// once means an edge came faster than the interrupt could follow; it has no
+// direction and is dropped.
+class QuadratureEncoder {
+public:
+  QuadratureEncoder() : inputA(0) {}
+
+  void begin(uint8_t pinA, uint8_t pinB) {
+    pinMode(pinA, INPUT_PULLUP);
+    pinMode(pinB, INPUT_PULLUP);
+    uint8_t oldSREG = SREG;
+    cli();
+    inputA = portInputRegister(digitalPinToPort(pinA));
+    inputB = portInputRegister(digitalPinToPort(pinB));
+    maskA = digitalPinToBitMask(pinA);
+    maskB = digitalPinToBitMask(pinB);
+    state = read();
+    count = 0;
+    SREG = oldSREG;
+    lastCount = 0;
+    lastMicros = micros();
+  }
+
+  void end() {
+    inputA = 0;
+  }
+
+  bool attached() const {
+    return inputA != 0;
+  }
+
+  void update() {
+    // prev << 2 | now, states as A << 1 | B; A leading B counts up
+    static const int8_t STEPS[16] = {
+       0, -1,  1,  0,
+       1,  0,  0, -1,
+      -1,  0,  0,  1,
+       0,  1, -1,  0
+    };
+    uint8_t now = read();
+    count += STEPS[(state << 2) | now];
+    state = now;
+  }
+
+  int32_t position() const {
+    uint8_t oldSREG = SREG;
+    cli();
+    int32_t value = count;
+    SREG = oldSREG;
+    return value;
+  }
+
+  void setPosition(int32_t value) {
+    uint8_t oldSREG = SREG;
+    cli();
+    count = value;
+    SREG = oldSREG;
+    lastCount = value;
+  }
+
+  // Counts per second since the previous call
+  float velocity() {
+    int32_t value = position();
+    unsigned long now = micros();
+    unsigned long elapsed = now - lastMicros;
+    float speed = elapsed ? (value - lastCount) * 1000000.0 / elapsed : 0;
+    lastCount = value;
+    lastMicros = now;
+    return speed;
+  }
+
+private:
+  volatile uint8_t *inputA;
+  volatile uint8_t *inputB;
+  uint8_t maskA;
+  uint8_t maskB;
+  uint8_t state;
+  volatile int32_t count;
+  int32_t lastCount;
+  unsigned long lastMicros;
+
+  uint8_t read() const {
+    return ((*inputA & maskA) ? 2 : 0) | ((*inputB & maskB) ? 1 : 0);
+  }
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef PidController_h
+#define PidController_h
+
+#include <stdint.h>
+
+#define PID_OUTPUT_MAX 255         // analogWrite range, the sign gives the direction
+#define PID_TERM_MAX (1L << 24)    // each term is clamped here so the sum cannot overflow
+
+// Fixed-point PID stepped at a fixed rate. Gains are Q8 (256 = 1.0) per step,
+// so Ki and Kd already include the step period. The derivative acts on the
+// measurement rather than the error, so a setpoint change does not kick the
+// output, and the integral is clamped to what the output can use so it does
+// not wind up while the motor is saturated.
+class PidController {
+public:
+  PidController() {
+    setGains(0, 0, 0);
+    reset();
+  }
+
+  void setGains(int16_t kp, int16_t ki, int16_t kd) {
+    this->kp = kp;
+    this->ki = ki;
+    this->kd = kd;
+  }
+
+  void reset() {
+    integral = 0;
+    primed = false;
+  }
+
+  // Returns the output for one step, -PID_OUTPUT_MAX..PID_OUTPUT_MAX
+  int16_t step(int32_t target, int32_t measured) {
+    int32_t error = clamp(target - measured, 32767);
+    int32_t change = primed ? clamp(measured - lastMeasured, 32767) : 0;
+    lastMeasured = measured;
+    primed = true;
+
+    integral = clamp(integral + (int32_t)ki * error, (int32_t)PID_OUTPUT_MAX << 8);
+    int32_t sum = clamp((int32_t)kp * error, PID_TERM_MAX)
+                + integral
+                - clamp((int32_t)kd * change, PID_TERM_MAX);
+    return clamp(sum >> 8, PID_OUTPUT_MAX);
+  }
+
+private:
+  int16_t kp;
+  int16_t ki;
+  int16_t kd;
+  int32_t integral;                // Q8
+  int32_t lastMeasured;
+  bool primed;
+
+  static int32_t clamp(int32_t value, int32_t limit) {
+    return value > limit ? limit : value < -limit ? -limit : value;
+  }
+};
+
+#endif
@@ -9,6 +9,8 @@
 
 // 서보 라이브러리
 #include <Servo.h>
+#include "QuadratureEncoder.h"
+#include "PidController.h"
 //#include <SoftwareSerial.h>  
 
 //LiquidCrystal_I2C lcd(0x3f,16,2);  // set the LCD address to 0x27 for a 16 chars and 2 line display
@@ -32,12 +34,29 @@ LiquidCrystal_I2C lcd(0x27,16,2);  // set the LCD address to 0x27 for a 16 chars
 #define SOUND_IN 11
 #define MOTOR_LEFT 12
 #define MOTOR_RIGHT 13
+#define ENCODER 14
+#define PID 15
+#define PID_GAIN 16
 
 
 // 상태 상수
 #define GET 1
 #define SET 2
 #define RESET 3
+#define IDENTIFY 5
+#define BAUD 6
+
+// 식별 응답 내용: 프로토콜 버전, 보드, 핀, 지원 장치 번호, 초당 최대 보고 횟수, 최대 통신 속도
+const char DESCRIPTOR[] PROGMEM = "v=1;b=mkboard;p=D0-13,A0-7;d=0-16;r=35;s=1000000";
+
+// 통신 속도 협상: 0~3 번 속도, 16MHz U2X 에서 250k/500k/1M 은 오차 없음
+#define BAUD_DEFAULT 115200UL
+#define BAUD_CONFIRM_MS 1000
+const unsigned long BAUD_RATES[] PROGMEM = {115200UL, 250000UL, 500000UL, 1000000UL};
+#define BAUD_RATE_COUNT (sizeof(BAUD_RATES) / sizeof(BAUD_RATES[0]))
+boolean baudPending = false;      // 새 속도로 바꾼 뒤 호스트의 확정을 기다리는 중
+uint8_t baudCode = 0xFF;          // 지금 쓰는 BAUD_RATES 번호, 0xFF 는 BAUD_DEFAULT
+unsigned long baudSwitchedAt = 0;
 
 // Motor 제어
 #define PHASE_B_L     8
@@ -81,6 +100,27 @@ int servo_pins[8]={0,0,0,0,0,0,0,0};
 // 울트라소닉 최종 값
 float lastUltrasonic = 0;
 
+// 엔코더(ENCODER): A, B 핀의 핀 변화 인터럽트로 위치를 세고, 보고 때마다 위치와 속도를 보냅니다.
+#define ENCODER_COUNT 2
+QuadratureEncoder encoders[ENCODER_COUNT];
+int encoderPins[ENCODER_COUNT][2] = {{-1, -1}, {-1, -1}};
+
+// PID 모터 제어: Timer0 비교 A 인터럽트(1.024ms)에서 PID_PERIOD_TICKS 마다 모터 출력을 다시 계산합니다.
+// 포트 0 은 왼쪽, 1 은 오른쪽 모터이고, MOTOR_LEFT/RIGHT 명령을 받으면 그 모터의 PID 는 꺼집니다.
+#define PID_OFF 0
+#define PID_SPEED 1                // 엔코더 속도, 초당 카운트
+#define PID_POSITION 2             // 엔코더 위치, 카운트
+#define PID_ANALOG 3               // 아날로그 입력 값
+#define PID_PERIOD_TICKS 10
+#define PID_SPEED_SCALE (15625L * 16 / PID_PERIOD_TICKS)   // 주기당 카운트 -> 초당 카운트, Q8
+#define MOTOR_COUNT 2
+PidController pids[MOTOR_COUNT];
+volatile uint8_t pidModes[MOTOR_COUNT] = {PID_OFF, PID_OFF};
+uint8_t pidInputs[MOTOR_COUNT];    // 엔코더 A 핀 또는 아날로그 핀
+long pidTargets[MOTOR_COUNT];
+long pidLastPositions[MOTOR_COUNT];
+volatile boolean adcBusy = false;  // loop() 가 ADC 를 쓰는 동안 아날로그 PID 는 한 주기 쉽니다.
+
 // 버퍼
 char buffer[52];
 unsigned char prevc=0;
@@ -119,7 +159,8 @@ void initPorts() {
 void setup()
 {
   initPorts();
-  Serial.begin(115200);  
+  Serial.begin(BAUD_DEFAULT);  
+  TIMSK0 |= _BV(OCIE0A);  // PID 주기, millis() 와 같은 Timer0 을 나눠 씁니다.
   // set the data rate for the SoftwareSerial port
   // mySerial.begin(115200);
   
@@ -154,6 +195,7 @@ void loop()
 
 
 #if 1
+  checkBaud();
   while (Serial.available()) 
   {
     if (Serial.available() > 0) 
@@ -264,10 +306,15 @@ void parseData() {
             delay(50);
           }
         }
+      } else if(device == ENCODER) {
+        attachEncoder(readBuffer(6), readBuffer(7));
       } else if(port == trigPin || port == echoPin) {
         setUltrasonicMode(false);
         digitals[port] = 0;
       } else {
+        if(device != ANALOG) {
+          releaseEncoder(port);
+        }
         digitals[port] = 0;
       }
     }
@@ -281,6 +328,14 @@ void parseData() {
       callOK();
     }
     break;
+    case IDENTIFY:{
+      sendIdentify();
+    }
+    break;
+    case BAUD:{
+      setBaud(device);
+    }
+    break;
   }
 }
 
@@ -331,6 +386,30 @@ void runModule(int device) {
       lastTime = millis()/1000.0; 
     }
     break;
+    case ENCODER:{
+      int slot = findEncoder(pin);
+      if(slot >= 0) {
+        encoders[slot].setPosition(readLong(7));
+      }
+    }
+    break;
+    case PID:{
+      // 모드, 입력 핀, 엔코더 B 핀, 목표 값(long)
+      if(pin < MOTOR_COUNT) {
+        setPid(pin, readBuffer(7), readBuffer(8), readBuffer(9), readLong(10));
+      }
+    }
+    break;
+    case PID_GAIN:{
+      // Kp, Ki, Kd (short, Q8: 256 = 1.0)
+      if(pin < MOTOR_COUNT) {
+        uint8_t oldSREG = SREG;
+        cli();
+        pids[pin].setGains(readShort(7), readShort(9), readShort(11));
+        SREG = oldSREG;
+      }
+    }
+    break;
     case LCD:{
       int line = readBuffer(7);  // Line
       int col = readBuffer(9);  // Col       
@@ -413,6 +492,7 @@ void runModule(int device) {
     }
     break;    
     case MOTOR_LEFT:{
+      pidModes[0] = PID_OFF;
       int direction = readBuffer(7);
       int speed = readBuffer(9);
 
@@ -448,6 +528,7 @@ void runModule(int device) {
     }
     break;
    case MOTOR_RIGHT:{
+      pidModes[1] = PID_OFF;
       int direction = readBuffer(7);
       int speed = readBuffer(9);
 
@@ -493,7 +574,7 @@ void runModule(int device) {
        // collect data for 50 mS
        while (millis() - startMillis < sound_max9812_sampleWindow)
        {
-          sound_max9812_sample = analogRead(pin);
+          sound_max9812_sample = readAnalog(pin);
           if (sound_max9812_sample < 1024)  // toss out spurious readings
           {
              if (sound_max9812_sample > signalMax)
@@ -532,6 +613,13 @@ void sendPinValues() {
     sendUltrasonic();  
     callOK();
   }
+
+  for (int i = 0; i < ENCODER_COUNT; i++) {
+    if(encoderPins[i][0] >= 0) {
+      sendEncoder(i);
+      callOK();
+    }
+  }
 }
 
 void setUltrasonicMode(boolean mode) {
@@ -563,6 +651,204 @@ void sendUltrasonic() {
   writeEnd();
 }
 
+int findEncoder(int pin) {
+  for (int i = 0; i < ENCODER_COUNT; i++) {
+    if(encoderPins[i][0] == pin || encoderPins[i][1] == pin) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// 0, 1번은 시리얼, A6/A7 은 디지털 입력이 안 되므로 2~13번만 씁니다.
+void attachEncoder(int pinA, int pinB) {
+  int slot = findEncoder(pinA);
+  if(slot >= 0 && encoderPins[slot][0] == pinA && encoderPins[slot][1] == pinB) {
+    return;
+  }
+  if(pinA < 2 || pinA >= MAX_DIGITAL_PIN || pinB < 2 || pinB >= MAX_DIGITAL_PIN || pinA == pinB) {
+    return;
+  }
+  releaseEncoder(pinA);
+  releaseEncoder(pinB);
+  slot = findEncoder(-1);
+  if(slot < 0) {
+    return;
+  }
+  if(pinA == trigPin || pinA == echoPin || pinB == trigPin || pinB == echoPin) {
+    setUltrasonicMode(false);
+  }
+  digitals[pinA] = 1;
+  digitals[pinB] = 1;
+
+  uint8_t oldSREG = SREG;
+  cli();
+  encoderPins[slot][0] = pinA;
+  encoderPins[slot][1] = pinB;
+  encoders[slot].begin(pinA, pinB);
+  *digitalPinToPCMSK(pinA) |= bit(digitalPinToPCMSKbit(pinA));
+  *digitalPinToPCMSK(pinB) |= bit(digitalPinToPCMSKbit(pinB));
+  PCICR |= bit(digitalPinToPCICRbit(pinA)) | bit(digitalPinToPCICRbit(pinB));
+  SREG = oldSREG;
+}
+
+// 엔코더가 쓰던 핀에 다른 장치를 쓰면 엔코더를 풀고 디지털 입력으로 돌려놓습니다.
+void releaseEncoder(int pin) {
+  int slot = findEncoder(pin);
+  if(slot < 0) {
+    return;
+  }
+  uint8_t oldSREG = SREG;
+  cli();
+  for (int i = 0; i < 2; i++) {
+    int p = encoderPins[slot][i];
+    *digitalPinToPCMSK(p) &= ~bit(digitalPinToPCMSKbit(p));
+    encoderPins[slot][i] = -1;
+    digitals[p] = 0;
+  }
+  encoders[slot].end();
+  SREG = oldSREG;
+}
+
+void updateEncoders() {
+  for (uint8_t i = 0; i < ENCODER_COUNT; i++) {
+    if(encoders[i].attached()) {
+      encoders[i].update();
+    }
+  }
+}
+
+ISR(PCINT0_vect) {
+  updateEncoders();
+}
+
+ISR(PCINT2_vect) {
+  updateEncoders();
+}
+
+/** 엔코더 값, 위치(long, 카운트)와 속도(float, 초당 카운트)
+    0xFF 0x55 7 위치 속도 A핀 B핀 ENCODER 0x0D 0x0A
+    위치부터 B핀까지는 0x0D 뒤마다 0x00 을 끼워 보냅니다.
+*/
+void sendEncoder(int slot) {
+  writeHead();
+  writeSerial(7);
+  val.longVal = encoders[slot].position();
+  for (int i = 0; i < 4; i++) {
+    writeStuffed(val.byteVal[i]);
+  }
+  val.floatVal = encoders[slot].velocity();
+  for (int i = 0; i < 4; i++) {
+    writeStuffed(val.byteVal[i]);
+  }
+  writeStuffed(encoderPins[slot][0]);
+  writeStuffed(encoderPins[slot][1]);
+  writeSerial(ENCODER);
+  writeEnd();
+}
+
+void setPid(int motor, int mode, int input, int inputB, long target) {
+  int slot = -1;
+  if(mode == PID_SPEED || mode == PID_POSITION) {
+    attachEncoder(input, inputB);
+    slot = findEncoder(input);
+    if(slot < 0 || encoderPins[slot][0] != input) {
+      mode = PID_OFF;
+    }
+  } else if(mode == PID_ANALOG) {
+    if(input >= MAX_ANALOG_PIN) {
+      mode = PID_OFF;
+    }
+  } else {
+    mode = PID_OFF;
+  }
+
+  if(mode != PID_OFF) {
+    setPortWritable(motor == 0 ? PHASE_B_L : PHASE_A_R);
+    setPortWritable(motor == 0 ? ENABLE_B_L : ENABLE_A_R);
+    if(motor == 0) {
+      pinMode(13, OUTPUT);
+      digitalWrite(13, HIGH);
+    }
+  }
+
+  uint8_t oldSREG = SREG;
+  cli();
+  if(mode != pidModes[motor] || input != pidInputs[motor]) {
+    pids[motor].reset();
+    if(mode == PID_SPEED) {
+      pidLastPositions[motor] = encoders[slot].position();
+    }
+  }
+  pidModes[motor] = mode;
+  pidInputs[motor] = input;
+  pidTargets[motor] = target;
+  SREG = oldSREG;
+
+  if(mode == PID_OFF) {
+    driveMotor(motor, 0);
+  }
+}
+
+// 부호 있는 출력(-255~255)으로 모터를 돌립니다. 양수가 전진입니다.
+void driveMotor(int motor, int output) {
+  boolean backward = output < 0;
+  if(motor == 0) {
+    digitalWrite(PHASE_B_L, backward ? HIGH : LOW);
+    analogWrite(ENABLE_B_L, backward ? -output : output);
+  } else {
+    digitalWrite(PHASE_A_R, backward ? LOW : HIGH);
+    analogWrite(ENABLE_A_R, backward ? -output : output);
+  }
+}
+
+// 인터럽트 안에서 부릅니다. 엔코더가 풀렸으면 PID 도 끕니다.
+void stepPid(int motor) {
+  long measured;
+  if(pidModes[motor] == PID_ANALOG) {
+    if(adcBusy) {
+      return;
+    }
+    measured = analogRead(pidInputs[motor]);
+  } else {
+    int slot = findEncoder(pidInputs[motor]);
+    if(slot < 0) {
+      pidModes[motor] = PID_OFF;
+      driveMotor(motor, 0);
+      return;
+    }
+    long position = encoders[slot].position();
+    if(pidModes[motor] == PID_SPEED) {
+      measured = ((position - pidLastPositions[motor]) * PID_SPEED_SCALE) >> 8;
+      pidLastPositions[motor] = position;
+    } else {
+      measured = position;
+    }
+  }
+  driveMotor(motor, pids[motor].step(pidTargets[motor], measured));
+}
+
+// 계산 중에도 엔코더 인터럽트가 들어올 수 있게 인터럽트를 켠 채로 돕니다.
+ISR(TIMER0_COMPA_vect, ISR_NOBLOCK) {
+  static uint8_t ticks = 0;
+  if(++ticks < PID_PERIOD_TICKS) {
+    return;
+  }
+  ticks = 0;
+  for (int i = 0; i < MOTOR_COUNT; i++) {
+    if(pidModes[i] != PID_OFF) {
+      stepPid(i);
+    }
+  }
+}
+
+int readAnalog(int pin) {
+  adcBusy = true;
+  int value = analogRead(pin);
+  adcBusy = false;
+  return value;
+}
+
 #define PHASE_B_L     8
 #define PHASE_A_R     7
 #define ENABLE_B_L    6
@@ -589,7 +875,7 @@ void sendAnalogValue(int pinNumber)
   }
   else  
   {
-    sendFloat(analogRead(pinNumber));  
+    sendFloat(readAnalog(pinNumber));  
   }
 
   writeSerial(pinNumber);
@@ -614,6 +900,14 @@ void writeSerial(unsigned char c){
   Serial.write(c);
 }
 
+// 값 안의 0x0D 0x0A 가 줄 끝으로 잘리지 않도록 0x0D 뒤에 0x00 을 붙입니다.
+void writeStuffed(unsigned char c) {
+  writeSerial(c);
+  if(c == 13) {
+    writeSerial(0);
+  }
+}
+
 void sendString(String s){
   int l = s.length();
   writeSerial(4);
@@ -675,12 +969,80 @@ int searchServoPin(int pin){
 }
 
 void setPortWritable(int pin) {
+  releaseEncoder(pin);
   if(digitals[pin] == 0) {
     digitals[pin] = 1;
     pinMode(pin, OUTPUT);
   } 
 }
 
+/** 식별 응답(엔트리->PC), 한 번의 왕복으로 보드를 알아볼 수 있게 합니다.
+    0xFF 0x55 4 길이 "v=1;b=...;h=빌드해시" 0 ALIVE 0x0D 0x0A
+*/
+void sendIdentify(){
+  uint8_t len = strlen_P(DESCRIPTOR);
+  uint16_t hash = buildHash();
+  writeHead();
+  writeSerial(4);
+  writeSerial(len + 7);
+  for (uint8_t i = 0; i < len; i++) {
+    writeSerial(pgm_read_byte(DESCRIPTOR + i));
+  }
+  writeSerial(';');
+  writeSerial('h');
+  writeSerial('=');
+  for (int8_t shift = 12; shift >= 0; shift -= 4) {
+    writeSerial("0123456789abcdef"[(hash >> shift) & 15]);
+  }
+  writeSerial(0);
+  writeSerial(ALIVE);
+  writeEnd();
+}
+
+// 컴파일 시각의 FNV-1a 해시, 빌드마다 달라집니다.
+uint16_t buildHash(){
+  const char *s = PSTR(__DATE__ " " __TIME__);
+  uint32_t hash = 2166136261UL;
+  for (char c; (c = pgm_read_byte(s)) != 0; s++) {
+    hash ^= (uint8_t)c;
+    hash *= 16777619UL;
+  }
+  return hash ^ (hash >> 16);
+}
+
+/** 통신 속도 변경(PC->엔트리), 응답을 보낸 뒤 새 속도로 바꿉니다.
+    지금 쓰는 속도의 번호를 다시 받으면 그 속도를 확정합니다.
+    0xFF 0x55 3 번호(short) 0 ALIVE 0x0D 0x0A
+*/
+void setBaud(uint8_t code){
+  if (code >= BAUD_RATE_COUNT) {
+    return;
+  }
+  writeHead();
+  sendShort(code);
+  writeSerial(0);
+  writeSerial(ALIVE);
+  writeEnd();
+  if (code == baudCode) {
+    baudPending = false;
+    return;
+  }
+  Serial.flush();
+  Serial.begin(pgm_read_dword(&BAUD_RATES[code]));
+  baudCode = code;
+  baudPending = true;
+  baudSwitchedAt = millis();
+}
+
+// 새 속도에서 확정을 받지 못하면 기본 속도로 돌아갑니다.
+void checkBaud(){
+  if (baudPending && millis() - baudSwitchedAt >= BAUD_CONFIRM_MS) {
+    baudPending = false;
+    baudCode = 0xFF;
+    Serial.begin(BAUD_DEFAULT);
+  }
+}
+
 void callOK(){
   writeSerial(0xff);
   writeSerial(0x55);
@@ -5,6 +5,7 @@
 #include "LCD1602.h"
 #include "SimpleDHT.h"
 #include "Adafruit_NeoPixel.h"
+#include "EdgeCapture.h"
 
 // noricoding 핀 설정
 #define PORT1D 5
@@ -44,6 +45,7 @@ const int DIGITAL_PINS[NORI_PORT_CNT] = {PORT1D, PORT2D, PORT3D, PORT4D};
 #define TOUCH       13
 #define TEXTLCD     14
 #define SEGMENT     15
+#define EDGE        16  // 버튼/터치 핀 변화 보고
 
 // 전역변수 선언 시작
 typedef struct tagPort {
@@ -72,6 +74,9 @@ typedef struct tagPort {
 
 Port ports[NORI_PORT_CNT];
 
+// 버튼/터치 포트의 핀 변화, 보고 주기보다 짧게 눌러도 놓치지 않습니다.
+EdgeCapture<NORI_PORT_CNT> edges;
+
 // 전역변수 선언 종료
 
 void actionGet(int idx, int port_idx, int device);
@@ -107,6 +112,7 @@ void initPorts() {
 }
 
 void sendModuleValues() {
+    sendEdgeEvents();
     for (int i = 0; i < NORI_PORT_CNT; i++) {
         sendModuleValue(ports[i]);
         callOK();
@@ -154,11 +160,15 @@ void initModule(Port& port, int device) {
 
         case VOLUME:
         case SOUND:
-        case BUTTON:
         case AMBIENT:
         case IRRANGE:
+            resetPort(port, INPUT, INPUT);
+            break;
+
+        case BUTTON:
         case TOUCH:
             resetPort(port, INPUT, INPUT);
+            armEdge(port);
             break;
         case TONE:
             break;
@@ -229,16 +239,19 @@ void delModule(Port& port) {
         case BUZZER:
         case VOLUME:
         case SOUND:
-        case BUTTON:
         case AMBIENT:
         case IRRANGE:
-        case TOUCH:
         case TONE:
         case ULTRASONIC:
         case MOTOR:
             // do nothing
             break;
 
+        case BUTTON:
+        case TOUCH:
+            disarmEdge(port);
+            break;
+
         case NEOPIXEL:
             if (port.devPixels != NULL) {
                 port.devPixels->clear();
@@ -353,7 +366,9 @@ void setModule(Port& port) {
 
 void sendDigitalStatus(Port& port) {
     writeHead();
+    unsigned long sampledAt = micros();
     sendShort(digitalRead(port.digital_pin));
+    writeStamp(sampledAt);
     writeSerial(port.index);
     writeSerial(port.status);
     writeEnd();
@@ -361,7 +376,9 @@ void sendDigitalStatus(Port& port) {
 
 void sendAnalogStatus(Port& port) {
     writeHead();
+    unsigned long sampledAt = micros();
     sendFloat(analogRead(port.analog_pin));
+    writeStamp(sampledAt);
     writeSerial(port.index);
     writeSerial(port.status);
     writeEnd();
@@ -378,6 +395,7 @@ void sendUltrasonic(Port& port) {
     digitalWrite(trigPin, LOW);
 
     float value = pulseIn(echoPin, HIGH) / 29.0 / 2.0;
+    unsigned long sampledAt = micros();
 
     if (value == 0) {
         value = port.ultrasonic;
@@ -387,6 +405,7 @@ void sendUltrasonic(Port& port) {
 
     writeHead();
     sendShort(value);
+    writeStamp(sampledAt);
     writeSerial(port.index);
     writeSerial(port.status);
     writeEnd();
@@ -394,9 +413,11 @@ void sendUltrasonic(Port& port) {
 
 void sendDHT11(Port& port) {
     port.devDHT->read2(&port.lastTemperature, &port.lastHumidity, NULL);
+    unsigned long sampledAt = micros();
 
     writeHead();
     sendTwinFloat(port.lastTemperature, port.lastHumidity);
+    writeStamp(sampledAt);
     writeSerial(port.index);
     writeSerial(port.status);
     writeEnd();
@@ -446,6 +467,85 @@ void sendModuleValue(Port& port) {
 
 }
 
+// 포트 1,2 = PD5,PD6 (PCINT2), 포트 3,4 = PB1,PB2 (PCINT0)
+void captureEdges() {
+    uint16_t now = millis();
+    for (int i = 0; i < NORI_PORT_CNT; i++) {
+        if (edges.armed(i)) {
+            edges.edge(i, digitalRead(ports[i].digital_pin), now);
+        }
+    }
+}
+
+ISR(PCINT0_vect) {
+    captureEdges();
+}
+
+ISR(PCINT2_vect) {
+    captureEdges();
+}
+
+void armEdge(Port& port) {
+    const int pin = port.digital_pin;
+    uint8_t oldSREG = SREG;
+    cli();
+    edges.arm(port.index, digitalRead(pin), millis());
+    *digitalPinToPCMSK(pin) |= bit(digitalPinToPCMSKbit(pin));
+    PCICR |= bit(digitalPinToPCICRbit(pin));
+    SREG = oldSREG;
+}
+
+void disarmEdge(Port& port) {
+    const int pin = port.digital_pin;
+    uint8_t oldSREG = SREG;
+    cli();
+    *digitalPinToPCMSK(pin) &= ~bit(digitalPinToPCMSKbit(pin));
+    edges.disarm(port.index);
+    SREG = oldSREG;
+}
+
+// 쌓인 핀 변화를 포트별로 묶어 보냅니다.
+// 0xFF 0x2D TYPE_EDGE 개수 (레벨, 경과 ms)... 포트 EDGE 0x0D 0x0A
+void sendEdgeEvents() {
+    EdgeEvent events[EDGE_QUEUE_SIZE];
+    uint8_t count = 0;
+
+    uint8_t oldSREG = SREG;
+    cli();
+    captureEdges();     // 디바운스 동안 놓친 마지막 변화
+    SREG = oldSREG;
+
+    while (count < EDGE_QUEUE_SIZE && edges.pop(events[count])) {
+        count++;
+    }
+    if (!isReportingEdges || count == 0) {
+        return;
+    }
+
+    uint16_t now = millis();
+    for (int i = 0; i < NORI_PORT_CNT; i++) {
+        uint8_t portCount = 0;
+        for (uint8_t j = 0; j < count; j++) {
+            if (events[j].slot == i) portCount++;
+        }
+        if (portCount == 0) {
+            continue;
+        }
+
+        writeHead();
+        writeSerial(TYPE_EDGE);
+        writeSerial(portCount);
+        for (uint8_t j = 0; j < count; j++) {
+            if (events[j].slot == i) {
+                writeEdge(events[j].level, EdgeCapture<NORI_PORT_CNT>::age(events[j], now));
+            }
+        }
+        writeSerial(i);
+        writeSerial(EDGE);
+        writeEnd();
+    }
+}
+
 void changeModule(Port& port, int device) {
     if (port.status == device) return;
 
@@ -9,6 +9,14 @@ unsigned char packetOffset = 0;
 
 uint8_t command_index = 0;
 
+// Timestamp, CFG_STAMP turns it on: delta to the previous report in 4us units
+#define STAMP_MAX 0xFFFF
+bool isStamping = false;
+unsigned long lastStamp = 0;
+
+// Edge event reports, CFG_EDGE turns them on
+bool isReportingEdges = false;
+
 ActionGetCallback actionGetCallback = NULL;
 ActionSetCallback actionSetCallback = NULL;
 ActionResetCallback actionResetCallback = NULL;
@@ -99,6 +107,17 @@ void dispatchPacket() {
             }
         }
             break;
+        case CFG: {
+            if (device == CFG_STAMP) {
+                isStamping = readShort();
+                lastStamp = micros();
+                callOK();
+            } else if (device == CFG_EDGE) {
+                isReportingEdges = readShort();
+                callOK();
+            }
+        }
+            break;
     }
 }
 
@@ -159,6 +178,39 @@ void sendShort(short value) {
     writeSerial(valShort.byteVal[1]);
 }
 
+// Sits between the value and port/device, so decoders that read those from
+// the end of the frame are unaffected. STAMP_MAX means a gap of 262ms or more.
+// Bytes 0x0D/0x0A are nudged away so the stamp can't form a line ending; the
+// extra time is paid back by the next delta.
+void writeStamp(unsigned long sampledAt) {
+    if (!isStamping) {
+        return;
+    }
+    long elapsed = sampledAt - lastStamp;
+    unsigned long delta = elapsed > 0 ? (unsigned long) elapsed >> 2 : 0;
+    if (delta >= STAMP_MAX) {
+        delta = STAMP_MAX;
+        lastStamp = sampledAt;
+    } else {
+        if ((delta >> 8) == 13) {
+            delta = 14 << 8;
+        }
+        if ((delta & 0xff) == 10 || (delta & 0xff) == 13) {
+            delta++;
+        }
+        lastStamp += delta << 2;
+    }
+    writeSerial(delta & 0xff);
+    writeSerial(delta >> 8);
+}
+
+// One edge of a TYPE_EDGE report: level and age in ms (13 bits). Both bytes
+// have the top bit set, so an event can never look like a line ending.
+void writeEdge(uint8_t level, uint16_t age) {
+    writeSerial(0x80 | (level << 6) | ((age >> 7) & 0x3F));
+    writeSerial(0x80 | (age & 0x7F));
+}
+
 short readShort() {
     valShort.byteVal[0] = readBuffer();
     valShort.byteVal[1] = readBuffer();
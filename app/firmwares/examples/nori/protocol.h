@@ -6,12 +6,19 @@
 #define RESET   3
 #define CFG     4
 
+// Configs (CFG device field)
+#define CFG_STAMP    1
+#define CFG_EDGE     2
+
+extern bool isReportingEdges;
+
 // Types
 #define TYPE_INT8    1
 #define TYPE_FLOAT   2
 #define TYPE_SHORT   3
 #define TYPE_TEXT    4
 #define TYPE_TWIN    5
+#define TYPE_EDGE    6
         
 // val Union
 union {
@@ -50,6 +57,8 @@ void sendText(String s);
 void sendFloat(float value);
 void sendShort(short value);
 void sendTwinFloat(float value1, float value2);
+void writeStamp(unsigned long sampledAt);
+void writeEdge(uint8_t level, uint16_t age);
 
 short readShort();
 float readFloat();
@@ -0,0 +1,75 @@
+#ifndef MovingAverage_h
+#define MovingAverage_h
+
+#include <stdint.h>
+
+// What the window averages:
+//   MOVING_AVERAGE_PLAIN    : the samples
+//   MOVING_AVERAGE_ABSOLUTE : |sample|
+//   MOVING_AVERAGE_RMS      : sample^2, value() returns the square root
+enum MovingAverageEnvelope {
+  MOVING_AVERAGE_PLAIN,
+  MOVING_AVERAGE_ABSOLUTE,
+  MOVING_AVERAGE_RMS
+};
+
+// Fixed-window moving average over the last WINDOW samples. The sum is kept
+// as a running total, so add() costs the same for any window size. The window
+// starts out filled with zeros.
+template <uint8_t WINDOW, MovingAverageEnvelope ENVELOPE = MOVING_AVERAGE_PLAIN>
+class MovingAverage {
+public:
+  MovingAverage() {
+    reset();
+  }
+
+  void reset() {
+    for (uint8_t i = 0; i < WINDOW; i++)
+      samples[i] = 0;
+    index = 0;
+    sum = 0;
+  }
+
+  // Adds a sample, dropping the oldest, and returns the new average
+  int add(int sample) {
+    sum += term(sample) - term(samples[index]);
+    samples[index] = sample;
+    if (++index >= WINDOW)
+      index = 0;
+    return value();
+  }
+
+  int value() const {
+    if (ENVELOPE == MOVING_AVERAGE_RMS)
+      return isqrt(sum / WINDOW);
+    return sum / (int32_t)WINDOW;
+  }
+
+private:
+  int samples[WINDOW];
+  uint8_t index;
+  int32_t sum;   // RMS keeps squares here, fine for 10-bit ADC samples
+
+  static int32_t term(int sample) {
+    if (ENVELOPE == MOVING_AVERAGE_ABSOLUTE)
+      return sample < 0 ? -(int32_t)sample : sample;
+    if (ENVELOPE == MOVING_AVERAGE_RMS)
+      return (int32_t)sample * sample;
+    return sample;
+  }
+
+  static int isqrt(uint32_t n) {
+    uint32_t root = 0;
+    for (uint32_t bit = 1UL << 30; bit; bit >>= 2) {
+      if (n >= root + bit) {
+        n -= root + bit;
+        root = (root >> 1) + bit;
+      } else {
+        root >>= 1;
+      }
+    }
+    return root;
+  }
+};
+
+#endif
@@ -14,6 +14,8 @@
  
 */
 
+#include "MovingAverage.h"
+
 // Sensor <--> Analog port mapping
 #define SoundSensor 0
 #define LightSensor 1
@@ -52,12 +54,10 @@ unsigned long lastIncommingMicroSec = 0;
 
 uint8_t incomingByte;
 
-const int sensorChannels = 8;
-const int maxNumReadings = 30;
-
-int smoothingValues[sensorChannels][maxNumReadings];
-int smoothingIndex[sensorChannels];
-int smoothingTotal[sensorChannels];
+MovingAverage<20> soundSmoothing;
+MovingAverage<20> lightSmoothing;
+MovingAverage<3> sliderSmoothing;
+MovingAverage<5> resistanceSmoothing[4];   // ResistanceA .. ResistanceD
 
 // motor variables
 byte motorDirectionA = 0;
@@ -68,7 +68,6 @@ byte isMotorOnB = 0;
 byte motorPowerB = 0;
 
 void setup() {
-     setupSmoothing();  
      Serial.begin(38400);
 
      // set pin mode for motor
@@ -80,16 +79,6 @@ void setup() {
      pinMode(THATWAY_PIN_B, OUTPUT);
 }
 
-void setupSmoothing() {
-     for(int i = 0; i < sensorChannels; i++) {
-       for(int j = 0 ; j < maxNumReadings ; j++) {
-         smoothingValues[i][j]=0;
-       }
-     smoothingTotal[i]=0;
-     smoothingIndex[i]=0;
-     }
-}
-
 void loop() {
     readSensors();
     
@@ -144,7 +133,7 @@ int readButton() {
 int readResistance(int adc) {
   int value;
   value = analogRead(adc);
-  value = smoothingValue(adc, value, 5);
+  value = resistanceSmoothing[adc - ResistanceA].add(value);
   if (value == 1022) value = 1023;
   return value;
 }
@@ -157,7 +146,7 @@ int readSlider() {
   if(sliderValue >= 690)
     sliderValue = 690;
   sliderValue = map(sliderValue, 0, 690, 0, 1023);
-  sliderValue = smoothingValue(Slider, sliderValue, 3);
+  sliderValue = sliderSmoothing.add(sliderValue);
   return sliderValue;
 }
 
@@ -165,7 +154,7 @@ int readLight() {
   int light;
   light = analogRead(LightSensor);
   light = calibrateLightSensor(light);
-  light = smoothingValue(LightSensor,light, 20);
+  light = lightSmoothing.add(light);
   return light;
 }
 
@@ -182,23 +171,10 @@ int calibrateLightSensor(int light) {
     return light;
 }
 
-int smoothingValue(int channel, int value, int numReadings) {
-    int total;
-    int index = smoothingIndex[channel];
-    total = smoothingTotal[channel] - smoothingValues[channel][index];
-    smoothingValues[channel][index] = value;
-    smoothingTotal[channel] = total + value;
-    smoothingIndex[channel]++;
-    if(smoothingIndex[channel] >=numReadings) {
-      smoothingIndex[channel]=0;
-    }
-    return int(round(smoothingTotal[channel] / (numReadings)));
-}
-
 int readSound() {
   int sound;
   sound = analogRead(SoundSensor);
-  sound = smoothingValue(SoundSensor,sound, 20);
+  sound = soundSmoothing.add(sound);
   // noise ceiling 
   if (sound < 60) { sound = 0; }
   return sound;
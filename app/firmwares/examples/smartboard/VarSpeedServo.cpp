@@ -77,7 +77,7 @@
 #define ticksToUs(_ticks) (( (unsigned)_ticks * 8)/ clockCyclesPerMicrosecond() ) // converts from ticks back to microseconds
 
 
-#define TRIM_DURATION       2                               // compensation ticks to trim adjust for digitalWrite delays // 12 August 2009
+#define TRIM_DURATION       2                               // compensation ticks to trim adjust for pin write delays // 12 August 2009
 
 //#define NBR_TIMERS        (MAX_SERVOS / SERVOS_PER_TIMER)
 
@@ -103,44 +103,53 @@ servoSequencePoint initSeq[] = {{0,100},{45,100}};
 
 /************ static functions common to all instances ***********************/
 
+static volatile uint16_t isrTicksLast;                      // duration of the last servo interrupt in timer ticks
+static volatile uint16_t isrTicksMax;                       // longest servo interrupt since the last reset
+
 static inline void handle_interrupts(timer16_Sequence_t timer, volatile uint16_t *TCNTn, volatile uint16_t* OCRnA)
 {
-  if( Channel[timer] < 0 )
+  uint16_t start = *TCNTn;
+  int8_t channel = Channel[timer];
+  servo_t *servo;
+
+  if( channel < 0 ) {
     *TCNTn = 0; // channel set to -1 indicated that refresh interval completed so reset the timer 
+    start = 0;
+  }
   else{
-    if( SERVO_INDEX(timer,Channel[timer]) < ServoCount && SERVO(timer,Channel[timer]).Pin.isActive == true )  
-      digitalWrite( SERVO(timer,Channel[timer]).Pin.nbr,LOW); // pulse this channel low if activated   
+    servo = &SERVO(timer,channel);
+    if( SERVO_INDEX(timer,channel) < ServoCount && servo->Pin.isActive == true )  
+      *servo->outReg &= ~servo->bitMask; // pulse this channel low if activated   
   }
 
-  Channel[timer]++;    // increment to the next channel
-  if( SERVO_INDEX(timer,Channel[timer]) < ServoCount && Channel[timer] < SERVOS_PER_TIMER) {
+  Channel[timer] = ++channel;    // increment to the next channel
+  if( SERVO_INDEX(timer,channel) < ServoCount && channel < SERVOS_PER_TIMER) {
+    servo = &SERVO(timer,channel);
+    *OCRnA = *TCNTn + servo->ticks;
+    if(servo->Pin.isActive == true)     // check if activated
+      *servo->outReg |= servo->bitMask; // its an active channel so pulse it high   
 
-	// Extension for slowmove
-	if (SERVO(timer,Channel[timer]).speed) {
+	// Extension for slowmove, after the pulse has started so it adds no jitter.
+	// The new width is used from the next refresh period.
+	if (servo->speed) {
 		// Increment ticks by speed until we reach the target.
 		// When the target is reached, speed is set to 0 to disable that code.
-		if (SERVO(timer,Channel[timer]).target > SERVO(timer,Channel[timer]).ticks) {
-			SERVO(timer,Channel[timer]).ticks += SERVO(timer,Channel[timer]).speed;
-			if (SERVO(timer,Channel[timer]).target <= SERVO(timer,Channel[timer]).ticks) {
-				SERVO(timer,Channel[timer]).ticks = SERVO(timer,Channel[timer]).target;
-				SERVO(timer,Channel[timer]).speed = 0;
+		if (servo->target > servo->ticks) {
+			servo->ticks += servo->speed;
+			if (servo->target <= servo->ticks) {
+				servo->ticks = servo->target;
+				servo->speed = 0;
 			}
 		}
 		else {
-			SERVO(timer,Channel[timer]).ticks -= SERVO(timer,Channel[timer]).speed;
-			if (SERVO(timer,Channel[timer]).target >= SERVO(timer,Channel[timer]).ticks) {
-				SERVO(timer,Channel[timer]).ticks = SERVO(timer,Channel[timer]).target;
-				SERVO(timer,Channel[timer]).speed = 0;
+			servo->ticks -= servo->speed;
+			if (servo->target >= servo->ticks) {
+				servo->ticks = servo->target;
+				servo->speed = 0;
 			}
 		}
 	}
 	// End of Extension for slowmove
-
-	// Todo
-	
-    *OCRnA = *TCNTn + SERVO(timer,Channel[timer]).ticks;
-    if(SERVO(timer,Channel[timer]).Pin.isActive == true)     // check if activated
-      digitalWrite( SERVO(timer,Channel[timer]).Pin.nbr,HIGH); // its an active channel so pulse it high   
   }  
   else { 
     // finished all channels so wait for the refresh period to expire before starting over 
@@ -150,6 +159,11 @@ static inline void handle_interrupts(timer16_Sequence_t timer, volatile uint16_t
       *OCRnA = *TCNTn + 4;  // at least REFRESH_INTERVAL has elapsed
     Channel[timer] = -1; // this will get incremented at the end of the refresh period to start again at the first channel
   }
+
+  uint16_t elapsed = *TCNTn - start;
+  isrTicksLast = elapsed;
+  if (elapsed > isrTicksMax)
+    isrTicksMax = elapsed;
 }
 
 #ifndef WIRING // Wiring pre-defines signal handlers so don't define any if compiling for the Wiring platform
@@ -318,7 +332,11 @@ uint8_t VarSpeedServo::attach(int pin, int min, int max)
 {
   if(this->servoIndex < MAX_SERVOS ) {
     pinMode( pin, OUTPUT) ;                                   // set servo pin to output
+    digitalWrite( pin, LOW) ;                                 // also turns off any PWM left on the pin
     servos[this->servoIndex].Pin.nbr = pin;  
+    // resolve the port once so the interrupt can write it directly
+    servos[this->servoIndex].outReg = portOutputRegister(digitalPinToPort(pin));
+    servos[this->servoIndex].bitMask = digitalPinToBitMask(pin);
     // todo min/max check: abs(min - MIN_PULSE_WIDTH) /4 < 128 
     this->min  = (MIN_PULSE_WIDTH - min)/4; //resolution of min/max is 4 uS
     this->max  = (MAX_PULSE_WIDTH - max)/4; 
@@ -331,6 +349,23 @@ uint8_t VarSpeedServo::attach(int pin, int min, int max)
   return this->servoIndex ;
 }
 
+uint16_t VarSpeedServo::isrMicroseconds(bool maximum)
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  uint16_t ticks = maximum ? isrTicksMax : isrTicksLast;
+  SREG = oldSREG;
+  return ticksToUs(ticks);
+}
+
+void VarSpeedServo::isrReset()
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  isrTicksMax = 0;
+  SREG = oldSREG;
+}
+
 void VarSpeedServo::detach()  
 {
   servos[this->servoIndex].Pin.isActive = false;  
@@ -510,6 +545,7 @@ uint8_t VarSpeedServo::sequencePlay(servoSequencePoint sequenceIn[], uint8_t num
 void VarSpeedServo::sequenceStop() {
   write(read());
   this->curSeqPosition = CURRENT_SEQUENCE_STOP;
+  this->curSequence = NULL; // the next sequencePlay starts over at startPos
 }
 
 /*
@@ -134,6 +134,8 @@ typedef struct  {
 
 typedef struct {
   ServoPin_t Pin;
+  volatile uint8_t *outReg;     // output port of Pin, resolved in attach()
+  uint8_t bitMask;              // bit of Pin in outReg
   unsigned int ticks;
 	unsigned int target;			// Extension for slowmove
 	uint8_t speed;					// Extension for slowmove
@@ -164,6 +166,8 @@ public:
   int read();                        // returns current pulse width as an angle between 0 and 180 degrees
   int readMicroseconds();            // returns current pulse width in microseconds for this servo (was read_us() in first release)
   bool attached();                   // return true if this servo is attached, otherwise false 
+  static uint16_t isrMicroseconds(bool maximum); // duration of the last (or longest) servo interrupt in microseconds
+  static void isrReset();            // clears the longest interrupt duration
 
   uint8_t sequencePlay(servoSequencePoint sequenceIn[], uint8_t numPositions, bool loop, uint8_t startPos);
   uint8_t sequencePlay(servoSequencePoint sequenceIn[], uint8_t numPositions); // play a looping sequence starting at position 0
@@ -0,0 +1,54 @@
+// Integer atan2 for the accelerometer tilt, table lookup with linear interpolation
+#define ATAN_TABLE_BITS 5
+
+// atan(i/32) for i = 0..32, in hundredths of a degree
+const uint16_t ATAN_TABLE[(1 << ATAN_TABLE_BITS) + 1] PROGMEM = {
+     0,  179,  358,  536,  713,  888, 1062, 1234,
+  1404, 1571, 1735, 1897, 2056, 2211, 2363, 2511,
+  2657, 2798, 2936, 3070, 3201, 3327, 3451, 3571,
+  3687, 3800, 3909, 4016, 4119, 4218, 4315, 4409,
+  4500
+};
+
+// Returns atan2(y, x) in tenths of a degree, -1800 to 1800
+int16_t atan2Deci(int16_t y, int16_t x) {
+  uint16_t ay = y < 0 ? -(int32_t)y : y;
+  uint16_t ax = x < 0 ? -(int32_t)x : x;
+  if (ax == 0 && ay == 0)
+    return 0;
+
+  // Reduce to the first octant so the ratio stays within 0..1
+  boolean steep = ay > ax;
+  uint32_t ratio = steep ? ((uint32_t)ax << 16) / ay : ((uint32_t)ay << 16) / ax; // Q16
+  uint8_t i = ratio >> (16 - ATAN_TABLE_BITS);
+  uint16_t frac = ratio & ((1 << (16 - ATAN_TABLE_BITS)) - 1);
+  uint16_t a = pgm_read_word(&ATAN_TABLE[i]);
+  if (frac)
+    a += ((uint32_t)(pgm_read_word(&ATAN_TABLE[i + 1]) - a) * frac) >> (16 - ATAN_TABLE_BITS);
+
+  int16_t angle = (a + 5) / 10;
+  if (steep)
+    angle = 900 - angle;
+  if (x < 0)
+    angle = 1800 - angle;
+  return y < 0 ? -angle : angle;
+}
+
+// Tenths of a degree to Q16.16 degrees, 65536 / 10 = 52429 / 8
+int32_t deciToQ16(int16_t deci) {
+  return ((int32_t)deci * 52429L) >> 3;
+}
+
+// Angle change in Q16.16 degrees over one sample from a raw gyro reading, with
+// stepQ14 = (deg/s per count) * dt in Q14. Both operands are 16 bit, so this is
+// a single 16x16 -> 32 multiply.
+int32_t gyroStepQ16(int16_t raw, uint16_t stepQ14) {
+  return ((int32_t)raw * (int32_t)stepQ14) >> 14;
+}
+
+// Complementary filter update comp += (acc - comp) * weight, weight in Q16. The
+// difference drops to Q8 first so the product stays in 32 bits for weights up to
+// 1/64 across the full 0 to 360 degree range.
+int32_t blendQ16(int32_t comp, int32_t acc, uint16_t weightQ16) {
+  return comp - (((comp - acc) >> 8) * (int32_t)weightQ16 >> 8);
+}
@@ -15,6 +15,8 @@ e-mail : kristianl@tkjelectronics.com
 #ifndef _Kalman_h
 #define _Kalman_h
 
+#include <stdint.h>
+
 class Kalman {
 public:
     Kalman() {
@@ -96,4 +98,105 @@ private:
     double S; // Estimate error - 1x1 matrix
 };
 
+/* Fixed point version of Kalman with the same steps, for MCUs without an FPU.
+ * Angles, rates and dt are signed Q(32-ANGLE_BITS).ANGLE_BITS numbers, e.g. 90 degrees is
+ * toFixed(90.0) = 90 << 16 with the default Q16.16. The covariance matrix and noise variances
+ * are well below 1, so they are kept in Q8.24 for resolution, and the gains are Q1.15.
+ * dt must fit in 16 bits (below 0.5 s at Q16.16), so every product is a 32 bit value times a
+ * 16 bit dt or gain, done as two 16x16 multiplies; the only division is one reciprocal of S. */
+template <uint8_t ANGLE_BITS = 16, uint8_t COV_BITS = 24>
+class KalmanFixed {
+public:
+    typedef int32_t fixed_t;
+
+    static fixed_t toFixed(double value) { return value * ((int32_t)1 << ANGLE_BITS); };
+    static double toDouble(fixed_t value) { return (double)value / ((int32_t)1 << ANGLE_BITS); };
+
+    KalmanFixed() {
+        /* Same defaults as Kalman */
+        setQangle(0.001);
+        setQbias(0.003);
+        setRmeasure(0.03);
+
+        angle = 0;
+        bias = 0; // Reset bias
+        rate = 0;
+        P[0][0] = 0;
+        P[0][1] = 0;
+        P[1][0] = 0;
+        P[1][1] = 0;
+    };
+    // The angle should be in degrees, the rate in degrees per second and the delta time in seconds, all as fixed_t
+    fixed_t getAngle(fixed_t newAngle, fixed_t newRate, fixed_t dt) {
+        int16_t dt16 = dt;
+
+        /* Step 1 */
+        rate = newRate - bias;
+        angle += mul(rate, dt16, ANGLE_BITS);
+
+        /* Step 2 */
+        P[0][0] += mul(mul(P[1][1], dt16, ANGLE_BITS) - P[0][1] - P[1][0] + Q_angle, dt16, ANGLE_BITS);
+        P[0][1] -= mul(P[1][1], dt16, ANGLE_BITS);
+        P[1][0] -= mul(P[1][1], dt16, ANGLE_BITS);
+        P[1][1] += mul(Q_bias, dt16, ANGLE_BITS);
+
+        /* Step 4 */
+        int32_t S = P[0][0] + R_measure;
+        if (S < 1)
+            S = 1;
+        /* Step 5 - K = P / S, through a 15 bit reciprocal of S normalized to [2^30, 2^31) */
+        uint32_t s = S;
+        uint8_t k = 0;
+        while (s < ((uint32_t)1 << 30)) {
+            s <<= 1;
+            k++;
+        }
+        int16_t r = (((uint32_t)1 << 30) - 1) / (uint16_t)(s >> 15); // 2^(45-k) / S, below 2^15
+        int16_t K0 = gain(P[0][0], r, k);
+        int16_t K1 = gain(P[1][0], r, k);
+
+        /* Step 3 */
+        fixed_t y = newAngle - angle;
+        /* Step 6 */
+        angle += mul(y, K0, 15);
+        bias += mul(y, K1, 15);
+
+        /* Step 7 */
+        P[0][0] -= mul(P[0][0], K0, 15);
+        P[0][1] -= mul(P[0][1], K0, 15);
+        P[1][0] -= mul(P[0][0], K1, 15);
+        P[1][1] -= mul(P[0][1], K1, 15);
+
+        return angle;
+    };
+    void setAngle(fixed_t newAngle) { angle = newAngle; }; // Used to set angle, this should be set as the starting angle
+    fixed_t getRate() { return rate; }; // Return the unbiased rate
+
+    /* These are used to tune the Kalman filter, in the same units as Kalman */
+    void setQangle(double newQ_angle) { Q_angle = newQ_angle * ((int32_t)1 << COV_BITS); };
+    void setQbias(double newQ_bias) { Q_bias = newQ_bias * ((int32_t)1 << COV_BITS); };
+    void setRmeasure(double newR_measure) { R_measure = newR_measure * ((int32_t)1 << COV_BITS); };
+
+private:
+    // (x * k) >> shift from the two 16x16 halves, exact up to shift 16 and within 1 above it
+    static int32_t mul(int32_t x, int16_t k, uint8_t shift) {
+        int32_t high = (int32_t)(int16_t)(x >> 16) * k;
+        int32_t low = (int32_t)(uint16_t)x * k;
+        if (shift > 16)
+            return (high >> (shift - 16)) + (low >> shift);
+        return (high << (16 - shift)) + (low >> shift);
+    };
+    // p / S in Q1.15 from the reciprocal r = 2^(45-k) / S, limited to +-1
+    static int16_t gain(int32_t p, int16_t r, uint8_t k) {
+        int32_t g = k < 30 ? mul(p, r, 30 - k) : mul(p, r, 0) << (k - 30);
+        return g > 32767 ? 32767 : g < -32767 ? -32767 : g;
+    };
+
+    int32_t Q_angle, Q_bias, R_measure; // Q8.24
+    fixed_t angle, bias, rate; // Q(32-ANGLE_BITS).ANGLE_BITS
+    int32_t P[2][2]; // Q8.24
+};
+
+typedef KalmanFixed<16, 24> KalmanQ16;
+
 #endif
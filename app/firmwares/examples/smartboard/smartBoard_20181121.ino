@@ -3,6 +3,7 @@
 #include "VarSpeedServo.h"
 #include "Kalman.h"
 #include "pitches.h"
+#include "EdgeCapture.h"
 
 #define SERVO_A 9
 #define SERVO_B 10
@@ -10,7 +11,7 @@
 #define DC_A 5
 #define DC_B 6   //
 
-Adafruit_TCS34725 tcs = Adafruit_TCS34725(TCeS34725_INTEGRATIONTIME_50MS, TCS34725_GAIN_4X);
+Adafruit_TCS34725 tcs = Adafruit_TCS34725(TCS34725_INTEGRATIONTIME_50MS, TCS34725_GAIN_4X);
 
 int remainData;
 const int M_SIZE=20;
@@ -27,25 +28,94 @@ int myServoSpeed[3] = { 52, 52, 52 };
 int myServoAngle[3] = { 12, 12, 12 };
 const int myServoPin[3] = { SERVO_A, SERVO_B, SERVO_C };
 
+/* Servo Sequence */
+// 100 ss ooo : sequence command for servo ss, data bytes follow for SEQ_ADD
+#define SEQ_MAX 16
+#define SEQ_CLEAR 0
+#define SEQ_ADD   1   // + 3 data bytes : bit0 position bit7 | bit1 speed bit7, position & 127, speed & 127
+#define SEQ_PLAY  2
+#define SEQ_LOOP  3
+#define SEQ_STOP  4
+#define SEQ_ADD_BYTES 3
+
+servoSequencePoint mySequence[3][SEQ_MAX];
+uint8_t mySequenceLength[3] = { 0, 0, 0 };
+uint8_t mySequenceMode[3] = { SEQ_STOP, SEQ_STOP, SEQ_STOP };
+uint8_t seqServo = 0;
+uint8_t seqRemain = 0;      // data bytes still expected for SEQ_ADD
+uint8_t seqData[SEQ_ADD_BYTES];
+
 int myDCMotorControl[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
 char wire = 0;   // 1 : RGB, 2 : GYRO, 2 : -, 3 : -, 4 : -
 
-Kalman kalmanX; // Create the Kalman instances
-Kalman kalmanY;
+/* Color Data */
+// pollColorSensor() only reads once the status register reports a finished
+// integration, so the report cycle never waits on the sensor.
+#define TCS_INTEGRATION_MS 50   // TCS34725_INTEGRATIONTIME_50MS
+
+struct ColorThreshold {
+  uint8_t color;
+  uint16_t rMin, rMax, gMin, gMax, bMin, bMax;
+};
+
+// Channel / average * 100, the first matching row wins, otherwise color 0
+const ColorThreshold colorTable[] = {
+  { 1, 131, 300,   0, 104,   0, 104 },   //RED
+  { 2,   0, 104, 126, 300,   0, 104 },   //GREEN
+  { 3,   0, 104,   0, 104, 131, 300 },   //BLUE
+};
+const uint8_t COLOR_TABLE_SIZE = sizeof(colorTable) / sizeof(colorTable[0]);
+
+uint16_t colorR, colorG, colorB, colorId;
+unsigned long colorMillis;
+
+KalmanQ16 kalmanX; // Create the Kalman instances, fixed point Q16.16
+KalmanQ16 kalmanY;
 
 /* IMU Data */
+// The MPU-6050 samples at IMU_RATE_HZ into its FIFO and every sample goes
+// through the filters in drainGyroFifo(); sendGyroData() only reports.
+#define IMU_RATE_HZ 200
+#define IMU_SAMPLE_BYTES 12   // accel XYZ + gyro XYZ
+#define IMU_FIFO_SIZE 1024
+#define IMU_DRAIN_MAX 4       // samples per loop pass, bounds the I2C time
+#define IMU_INIT_TRIES 10
+const int32_t IMU_DT_Q16 = (65536L + IMU_RATE_HZ / 2) / IMU_RATE_HZ;
+// Complementary filter accelerometer weight per sample, Q16. The filter used to
+// take 0.07 once per 40 ms report; 1 - 0.93^(5 ms / 40 ms) = 0.00903 per 5 ms
+// sample keeps the same time constant. Recompute if IMU_RATE_HZ changes.
+const uint16_t COMP_ACC_WEIGHT_Q16 = 592;
+// Gyro step per raw count and sample in Q14: 1 / 131 deg/s (65536 / 131 = 32018 / 64) times dt
+const uint16_t GYRO_STEP_Q14 = (32018L * IMU_DT_Q16 + 128) >> 8;
+
 int16_t accX, accY, accZ;
-int16_t tempRaw;
 int16_t gyroX, gyroY, gyroZ;
 
-double accXangle, accYangle; // Angle calculate using the accelerometer
-double temp; // Temperature
-double gyroXangle, gyroYangle; // Angle calculate using the gyro
-double compAngleX, compAngleY; // Calculate the angle using a complementary filter
-double kalAngleX, kalAngleY; // Calculate the angle using a Kalman filter
+int16_t accXangle, accYangle; // Angle calculate using the accelerometer, tenths of a degree 0 to 3600
+int32_t gyroXangle, gyroYangle; // Angle calculate using the gyro, Q16.16
+int32_t compAngleX, compAngleY; // Calculate the angle using a complementary filter, Q16.16
+int32_t kalAngleX, kalAngleY; // Calculate the angle using a Kalman filter, Q16.16
 
-uint32_t timer;
 uint8_t i2cData[14]; // Buffer for I2C data
+
+/* Button Edges */
+// Pins 12-15 are captured on pin change, so a press shorter than the report
+// interval still shows up. Each edge goes out ahead of the level reports:
+//   10 pppp 1 v, 0 aaaaaaa : v = pressed, a = ms since the edge, 127 = older
+#define EDGE_PIN_FIRST 12
+#define EDGE_PINS 4
+#define EDGE_AGE_REPORT_MAX 127
+
+EdgeCapture<EDGE_PINS> edges;
+
+/* Debug Reports */
+// 100 11 ooo : debug request (servo field 3), answered once with the next reports
+//   10 0000 1 0, 0 vvvvvvv : pin 0 is never a button edge, v = the value
+#define DEBUG_REQUEST 3
+#define DEBUG_SERVO_ISR 0     // longest servo interrupt in us since the last request, 127 = longer
+#define DEBUG_REPORT_MAX 127
+
+boolean reportServoIsr = false;
 ////////////////////////////
 
 void setup(){
@@ -59,23 +129,22 @@ void setup(){
     wire = 2;
 
     /* Set kalman and gyro starting angle */
-    while (i2cRead(0x3B, i2cData, 6));
+    for (int i = 0; i < IMU_INIT_TRIES && i2cRead(0x3B, i2cData, 6); i++);
     accX = ((i2cData[0] << 8) | i2cData[1]);
     accY = ((i2cData[2] << 8) | i2cData[3]);
     accZ = ((i2cData[4] << 8) | i2cData[5]);
-    // atan2 outputs the value of -π to π (radians) - see http://en.wikipedia.org/wiki/Atan2
-    // We then convert it to 0 to 2π and then from radians to degrees
-    accYangle = (atan2(accX, accZ) + PI) * RAD_TO_DEG;
-    accXangle = (atan2(accY, accZ) + PI) * RAD_TO_DEG;
-  
-    kalmanX.setAngle(accXangle); // Set starting angle
-    kalmanY.setAngle(accYangle);
-    gyroXangle = accXangle;
-    gyroYangle = accYangle;
-    compAngleX = accXangle;
-    compAngleY = accYangle;
+    // atan2Deci outputs -180 to 180 degrees in tenths, shifted to 0 to 360
+    accYangle = atan2Deci(accX, accZ) + 1800;
+    accXangle = atan2Deci(accY, accZ) + 1800;
   
-    timer = micros();
+    kalAngleX = deciToQ16(accXangle);
+    kalAngleY = deciToQ16(accYangle);
+    kalmanX.setAngle(kalAngleX); // Set starting angle
+    kalmanY.setAngle(kalAngleY);
+    gyroXangle = compAngleX = kalAngleX;
+    gyroYangle = compAngleY = kalAngleY;
+
+    resetGyroFifo();
   }
   else if (tcs.begin()) {
     wire = 1;
@@ -85,8 +154,9 @@ void setup(){
 
 boolean gyroBegin() {
   Wire.begin();
-  i2cData[0] = 7; // Set the sample rate to 1000Hz - 8kHz/(7+1) = 1000Hz
-  i2cData[1] = 0x00; // Disable FSYNC and set 260 Hz Acc filtering, 256 Hz Gyro filtering, 8 KHz sampling
+  Wire.setClock(400000); // FIFO bursts at fast mode
+  i2cData[0] = 1000 / IMU_RATE_HZ - 1; // Set the sample rate to 200Hz - 1kHz/(4+1) = 200Hz
+  i2cData[1] = 0x03; // Disable FSYNC and set 44 Hz Acc filtering, 42 Hz Gyro filtering, 1 KHz sampling
   i2cData[2] = 0x00; // Set Gyro Full Scale Range to ±250deg/s
   i2cData[3] = 0x00; // Set Accelerometer Full Scale Range to ±2g
   i2cWrite(0x19, i2cData, 4, false); // Write to all four registers at once
@@ -98,6 +168,63 @@ boolean gyroBegin() {
   return true;
 }
 
+void resetGyroFifo() {
+  i2cWrite(0x6A, 0x04, true); // USER_CTRL: FIFO_RESET
+  i2cWrite(0x23, 0x78, true); // FIFO_EN: gyro XYZ + accel
+  i2cWrite(0x6A, 0x40, true); // USER_CTRL: FIFO_EN
+}
+
+// Run every sample waiting in the MPU-6050 FIFO through the filters, at most
+// IMU_DRAIN_MAX per call. A failed read may have consumed part of a sample, so
+// the FIFO is reset rather than read out of alignment.
+void drainGyroFifo() {
+  if (i2cRead(0x72, i2cData, 2)) // FIFO_COUNT
+    return;
+  uint16_t count = (i2cData[0] << 8) | i2cData[1];
+  if (count > IMU_FIFO_SIZE - IMU_SAMPLE_BYTES) {
+    // Overflowed, so the sample boundaries are lost; start over
+    resetGyroFifo();
+    return;
+  }
+  for (uint8_t n = min(count / IMU_SAMPLE_BYTES, IMU_DRAIN_MAX); n > 0; n--) {
+    if (i2cRead(0x74, i2cData, IMU_SAMPLE_BYTES)) { // FIFO_R_W
+      resetGyroFifo();
+      return;
+    }
+    updateGyroAngles();
+  }
+}
+
+void updateGyroAngles() {
+  accX = ((i2cData[0] << 8) | i2cData[1]);
+  accY = ((i2cData[2] << 8) | i2cData[3]);
+  accZ = ((i2cData[4] << 8) | i2cData[5]);
+  gyroX = ((i2cData[6] << 8) | i2cData[7]);
+  gyroY = ((i2cData[8] << 8) | i2cData[9]);
+  gyroZ = ((i2cData[10] << 8) | i2cData[11]);
+
+  // atan2Deci outputs -180 to 180 degrees in tenths, shifted to 0 to 360
+  accXangle = atan2Deci(accY, accZ) + 1800;
+  accYangle = atan2Deci(accX, accZ) + 1800;
+  int32_t accXangleQ16 = deciToQ16(accXangle);
+  int32_t accYangleQ16 = deciToQ16(accYangle);
+
+  // Rates in Q16.16 deg/s, raw / 131 at ±250deg/s
+  int32_t gyroXrate = ((int32_t)gyroX * 32018) >> 6;
+  int32_t gyroYrate = -(((int32_t)gyroY * 32018) >> 6);
+  int32_t gyroXstep = gyroStepQ16(gyroX, GYRO_STEP_Q14);
+  int32_t gyroYstep = -gyroStepQ16(gyroY, GYRO_STEP_Q14);
+  gyroXangle += gyroXstep; // Calculate gyro angle without any filter
+  gyroYangle += gyroYstep;
+
+  // Complementary filter, comp = (1 - w) * (comp + rate * dt) + w * acc
+  compAngleX = blendQ16(compAngleX + gyroXstep, accXangleQ16, COMP_ACC_WEIGHT_Q16);
+  compAngleY = blendQ16(compAngleY + gyroYstep, accYangleQ16, COMP_ACC_WEIGHT_Q16);
+
+  kalAngleX = kalmanX.getAngle(accXangleQ16, gyroXrate, IMU_DT_Q16); // Calculate the angle using a Kalman filter
+  kalAngleY = kalmanY.getAngle(accYangleQ16, gyroYrate, IMU_DT_Q16);
+}
+
 void initPorts () {
   for (int pinNumber = 0; pinNumber < 13; pinNumber++) {
     if( (pinNumber != SERVO_A) && (pinNumber != SERVO_B) && (pinNumber != SERVO_C) ) {  pinMode(pinNumber, OUTPUT); digitalWrite(pinNumber, LOW); }
@@ -109,6 +236,34 @@ void initPorts () {
   for (int pinNumber = 12; pinNumber < 16; pinNumber++) {
     pinMode(pinNumber, INPUT_PULLUP);
   }
+  armEdges();
+}
+
+void armEdges() {
+  uint16_t now = millis();
+  for (uint8_t i = 0; i < EDGE_PINS; i++)
+    edges.arm(i, digitalRead(EDGE_PIN_FIRST + i), now);
+  PCMSK0 |= _BV(PCINT4) | _BV(PCINT5);   // D12, D13
+  PCMSK1 |= _BV(PCINT8) | _BV(PCINT9);   // A0, A1
+  PCICR |= _BV(PCIE0) | _BV(PCIE1);
+}
+
+// A pin the host switched to output is not a button, skip it
+void captureEdges() {
+  uint16_t now = millis();
+  for (uint8_t i = 0; i < EDGE_PINS; i++) {
+    uint8_t pin = EDGE_PIN_FIRST + i;
+    if (!(*portModeRegister(digitalPinToPort(pin)) & digitalPinToBitMask(pin)))
+      edges.edge(i, digitalRead(pin), now);
+  }
+}
+
+ISR(PCINT0_vect) {
+  captureEdges();
+}
+
+ISR(PCINT1_vect) {
+  captureEdges();
 }
 
 void loop() {
@@ -121,6 +276,12 @@ void loop() {
       }
     }
 
+   if (wire == 1) {
+     pollColorSensor();
+   } else if (wire == 2) {
+     drainGyroFifo();
+   }
+
    if (currentMillis - previousMillis[0] >= interval) {
     previousMillis[0] = currentMillis;
     sendPinValues();
@@ -139,6 +300,8 @@ void loop() {
 
   if (currentMillis - previousMillis[1] >= motorInterval) {
     previousMillis[1] = currentMillis;
+
+    playServoSequences();
      
     if(myDCMotorControl[0] > myDCMotorControl[2] ) {
       analogWrite(5, myDCMotorControl[2]++);
@@ -167,6 +330,8 @@ void loop() {
 
 void sendPinValues() {
   int pinNumber = 0;
+  sendEdgeEvents();
+  sendDebugReports();
   for (pinNumber = 12; pinNumber < 16; pinNumber++) {
       sendDigitalValue(pinNumber);
   }
@@ -197,42 +362,41 @@ void sendEmptyData() {
   Serial.write(0 & B1111111);
 }
 
-void sendRGBData() {
-   uint16_t clear, red, green, blue, color, r, g, b;
-   float average;
-   tcs.getRawData(&red, &green, &blue, &clear);
-
-  average = (red+green+blue)/3;
-  r = fastf2i_round(red/average*100);
-  g = fastf2i_round(green/average*100);
-  b = fastf2i_round(blue/average*100);
-
-  if ((r > 130) && (g < 105) && (b < 105)) {    //RED
-    color = 1;
-  }
-//  else if ((r > 170) && (g >= 63) && (b < 70)) {    //ORANGE
-//    color = 2;
-//  }
-//  else if ((r > 130) && (g > 95) && (b < 60)) {   //YELLOW
-//    color = 3;
-//  }
-  else if ((r < 105) && (g > 125) && (b < 105)) {   //GREEN
-    color = 2;
+void pollColorSensor() {
+  if (millis() - colorMillis < TCS_INTEGRATION_MS)
+    return;
+  if (!(tcs.read8(TCS34725_STATUS) & TCS34725_STATUS_AVALID))
+    return;
+  colorMillis = millis();
+
+  uint16_t red = tcs.read16(TCS34725_RDATAL);
+  uint16_t green = tcs.read16(TCS34725_GDATAL);
+  uint16_t blue = tcs.read16(TCS34725_BDATAL);
+  uint32_t sum = (uint32_t)red + green + blue;
+  if (sum == 0) {
+    colorR = colorG = colorB = colorId = 0;
+    return;
   }
-  else if ((r < 105) && (g < 105) && (b > 130)) {   //BLUE
-    color = 3;
-  }
-//  else if ((r > 80) && (g < 120) && (b > 100)) {     //DARK BLUE
-//    color = 6;
-//  }
-//  else if ((r > 1.10) && (g < 1) && (b < 1)) {    //PURPLE
-//    color = 7;
-//  } 
-  else {
-    color = 0;
+
+  // channel / ((red+green+blue)/3) * 100
+  colorR = ((uint32_t)red * 300 + sum / 2) / sum;
+  colorG = ((uint32_t)green * 300 + sum / 2) / sum;
+  colorB = ((uint32_t)blue * 300 + sum / 2) / sum;
+
+  colorId = 0;
+  for (uint8_t i = 0; i < COLOR_TABLE_SIZE; i++) {
+    const ColorThreshold &t = colorTable[i];
+    if (colorR >= t.rMin && colorR <= t.rMax
+        && colorG >= t.gMin && colorG <= t.gMax
+        && colorB >= t.bMin && colorB <= t.bMax) {
+      colorId = t.color;
+      break;
+    }
   }
+}
 
-  //Serial.print((int)r ); Serial.print(" "); Serial.print((int)g);Serial.print(" ");  Serial.println((int)b );
+void sendRGBData() {
+  uint16_t color = colorId, r = colorR, g = colorG, b = colorB;
 
   Serial.write(B11000000
                | ((0 & B111)<<3)
@@ -256,48 +420,18 @@ void sendRGBData() {
 }
 
 void sendGyroData() {
-  while (i2cRead(0x3B, i2cData, 14));
-  accX = ((i2cData[0] << 8) | i2cData[1]);
-  accY = ((i2cData[2] << 8) | i2cData[3]);
-  accZ = ((i2cData[4] << 8) | i2cData[5]);
-  tempRaw = ((i2cData[6] << 8) | i2cData[7]);
-  gyroX = ((i2cData[8] << 8) | i2cData[9]);
-  gyroY = ((i2cData[10] << 8) | i2cData[11]);
-  gyroZ = ((i2cData[12] << 8) | i2cData[13]);
-
-  // atan2 outputs the value of -π to π (radians) - see http://en.wikipedia.org/wiki/Atan2
-  // We then convert it to 0 to 2π and then from radians to degrees
-  accXangle = (atan2(accY, accZ) + PI) * RAD_TO_DEG;
-  accYangle = (atan2(accX, accZ) + PI) * RAD_TO_DEG;
-
-  double gyroXrate = (double)gyroX / 131.0;
-  double gyroYrate = -((double)gyroY / 131.0);
-  gyroXangle += gyroXrate * ((double)(micros() - timer) / 1000000); // Calculate gyro angle without any filter
-  gyroYangle += gyroYrate * ((double)(micros() - timer) / 1000000);
-
-
-  compAngleX = (0.93 * (compAngleX + (gyroXrate * (double)(micros() - timer) / 1000000))) + (0.07 * accXangle); // Calculate the angle using a Complimentary filter
-  compAngleY = (0.93 * (compAngleY + (gyroYrate * (double)(micros() - timer) / 1000000))) + (0.07 * accYangle);
-
-  kalAngleX = kalmanX.getAngle(accXangle, gyroXrate, (double)(micros() - timer) / 1000000); // Calculate the angle using a Kalman filter
-  if(kalAngleX < 0 ) kalAngleX = 0;
-  if(kalAngleX > 360 ) kalAngleX = 360;
-  kalAngleY = kalmanY.getAngle(accYangle, gyroYrate, (double)(micros() - timer) / 1000000);
-  if(kalAngleY < 0 ) kalAngleY = 0;
-  if(kalAngleY > 360 ) kalAngleY = 360;
-  timer = micros();
-
-  temp = ((double)tempRaw + 12412.0) / 340.0;
+  int angleX = constrain(kalAngleX >> 16, 0, 360);
+  int angleY = constrain(kalAngleY >> 16, 0, 360);
 
   Serial.write(B11000000
                | ((0 & B111)<<3)
-               | ((map(kalAngleX, 0, 360, 0, 360)>>7) & B111));
-  Serial.write(map(kalAngleX, 0, 360, 0, 360) & B1111111);
+               | ((angleX>>7) & B111));
+  Serial.write(angleX & B1111111);
   
   Serial.write(B11000000
                | ((1 & B111)<<3)
-               | ((map(kalAngleY, 0, 360, 0, 360)>>7) & B111));
-  Serial.write(map(kalAngleY, 0, 360, 0, 360) & B1111111);
+               | ((angleY>>7) & B111));
+  Serial.write(angleY & B1111111);
 
   Serial.write(B11000000
                | ((6 & B111)<<3)
@@ -311,8 +445,17 @@ void sendGyroData() {
 }
 
 void updateDigitalPort (char c) {
+  if (seqRemain && !(c>>7)) {
+    updateServoSequence(c);
+    return;
+  }
+  seqRemain = 0;
+
   // first data
-  if (c>>7) {
+  if ((c & B11100000) == B10000000) {
+    updateServoSequence(c);
+  }
+  else if (c>>7) {
     // is output
     if ((c>>6) & 1) {
       // is data end at this chunk
@@ -362,6 +505,7 @@ void updateDigitalPort (char c) {
         if( value > 0 && value <= 185 ) { 
           value = map(value, 1, 180, 12, 168);
           if(myServoAngle[port-9] != value ) {
+            mySequenceMode[port-9] = SEQ_STOP;
             myServo[port-9].write(value, myServoSpeed[port-9]); 
             myServoAngle[port-9] = value;
           }
@@ -371,6 +515,59 @@ void updateDigitalPort (char c) {
   }
 }
 
+void updateServoSequence (char c) {
+  if (c>>7) {
+    seqServo = (c >> 3) & B11;
+    if (seqServo == DEBUG_REQUEST) {
+      if ((c & B111) == DEBUG_SERVO_ISR) reportServoIsr = true;
+      return;
+    }
+    switch (c & B111) {
+      case SEQ_CLEAR:
+        stopServoSequence(seqServo);
+        mySequenceLength[seqServo] = 0;
+        break;
+      case SEQ_ADD:
+        seqRemain = SEQ_ADD_BYTES;
+        break;
+      case SEQ_PLAY:
+      case SEQ_LOOP:
+        if (mySequenceLength[seqServo] == 0) break;
+        myServo[seqServo].sequenceStop(); // rewinds to the first point
+        mySequenceMode[seqServo] = c & B111;
+        break;
+      case SEQ_STOP:
+        stopServoSequence(seqServo);
+        break;
+    }
+    return;
+  }
+
+  seqData[SEQ_ADD_BYTES - seqRemain] = c;
+  if (--seqRemain) return;
+  uint8_t position = ((seqData[0] & 1) << 7) | seqData[1];
+  uint8_t speed = ((seqData[0] & 2) << 6) | seqData[2];
+  if (mySequenceLength[seqServo] < SEQ_MAX && position > 0 && position <= 180) {
+    servoSequencePoint &point = mySequence[seqServo][mySequenceLength[seqServo]++];
+    point.position = map(position, 1, 180, 12, 168);
+    point.speed = speed;
+  }
+}
+
+void stopServoSequence (uint8_t servo) {
+  if (mySequenceMode[servo] != SEQ_STOP) {
+    mySequenceMode[servo] = SEQ_STOP;
+    myServo[servo].sequenceStop();
+  }
+}
+
+void playServoSequences () {
+  for (uint8_t i = 0; i < 3; i++) {
+    if (mySequenceMode[i] == SEQ_STOP) continue;
+    if (myServo[i].sequencePlay(mySequence[i], mySequenceLength[i], mySequenceMode[i] == SEQ_LOOP, 0) == CURRENT_SEQUENCE_STOP)
+      mySequenceMode[i] = SEQ_STOP;
+  }
+}
 
 void sendAnalogValue(int pinNumber) {
   int value;
@@ -381,6 +578,32 @@ void sendAnalogValue(int pinNumber) {
   Serial.write(value & B1111111);
 }
 
+void sendEdgeEvents() {
+  uint8_t oldSREG = SREG;
+  cli();
+  captureEdges();   // a change the debounce window swallowed
+  SREG = oldSREG;
+
+  uint16_t now = millis();
+  EdgeEvent event;
+  while (edges.pop(event)) {
+    uint16_t age = EdgeCapture<EDGE_PINS>::age(event, now);
+    Serial.write(B10000010
+                 | (((EDGE_PIN_FIRST + event.slot) & B1111)<<2)
+                 | (event.level == LOW ? B1 : 0));
+    Serial.write(age > EDGE_AGE_REPORT_MAX ? EDGE_AGE_REPORT_MAX : age);
+  }
+}
+
+void sendDebugReports() {
+  if (!reportServoIsr) return;
+  reportServoIsr = false;
+  uint16_t us = VarSpeedServo::isrMicroseconds(true);
+  VarSpeedServo::isrReset();
+  Serial.write(B10000010);
+  Serial.write(us > DEBUG_REPORT_MAX ? DEBUG_REPORT_MAX : us);
+}
+
 void sendDigitalValue(int pinNumber) {
   if (digitalRead(pinNumber) == HIGH) {
     Serial.write(B10000000
@@ -412,18 +635,3 @@ boolean isPortWritable (int port) {
   else
     return bitRead(DDRD, port);
 }
-
-int fastf2i_round(float f)
-{
-#ifdef _WIN32
- int i;
- __asm
- {
-  fld  f
-  fistp i
- }
- return i;
-#else
- return (int)(f + 0.5f);
-#endif 
-}
@@ -0,0 +1,51 @@
+// Host test: atan2Deci against atan2 over the whole circle and the
+// accelerometer's input range. Build and run with `make -C test`.
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define PROGMEM
+#define pgm_read_word(address) (*(address))
+typedef bool boolean;
+#include "../angle.ino"
+
+#define MAX_ERROR 0.1 // degrees, including the rounding to tenths
+
+static double maxError = 0;
+static int worstY, worstX;
+
+static void check(int16_t y, int16_t x) {
+    double expected = atan2((double)y, (double)x) * 180 / M_PI;
+    double error = fabs(atan2Deci(y, x) / 10.0 - expected);
+    if (error > 180) // -180 and 180 are the same direction
+        error = fabs(error - 360);
+    if (error > maxError) {
+        maxError = error;
+        worstY = y;
+        worstX = x;
+    }
+}
+
+int main() {
+    // Every 0.01 degree at several vector lengths, up to the int16 limit
+    static const double radii[] = { 100, 1000, 4096, 16384, 32767 };
+    for (unsigned r = 0; r < sizeof(radii) / sizeof(radii[0]); r++) {
+        for (long i = 0; i < 36000; i++) {
+            double a = i * M_PI / 18000;
+            check(lround(radii[r] * sin(a)), lround(radii[r] * cos(a)));
+        }
+    }
+    // Small vectors, where the ratio is coarsest
+    for (int y = -64; y <= 64; y++)
+        for (int x = -64; x <= 64; x++)
+            check(y, x);
+    // Axis and extreme inputs
+    check(-32768, 1);
+    check(1, -32768);
+    check(-32768, -32768);
+    check(32767, -32768);
+
+    bool ok = maxError <= MAX_ERROR;
+    printf("%s atan2Deci max error %.4f deg at (%d, %d)\n", ok ? "ok  " : "FAIL", maxError, worstY, worstX);
+    return !ok;
+}
@@ -0,0 +1,51 @@
+// AVR benchmark: CPU cycles per getAngle() for Kalman and KalmanQ16.
+// Build with `make -C test bench` (avr-gcc, ATmega328P at 16 MHz) and run it
+// on a board or in simavr; it prints the averages once at 115200 baud.
+#include <avr/io.h>
+#include <stdio.h>
+#include "../kalman.h"
+
+#define RUNS 64
+
+static int uartPut(char c, FILE *) {
+    while (!(UCSR0A & _BV(UDRE0)));
+    UDR0 = c;
+    return 0;
+}
+
+static FILE uart;
+
+// Timer1 counts CPU cycles, a run is well below 65536 of them
+static uint16_t cycles() {
+    return TCNT1;
+}
+
+int main() {
+    UCSR0A = _BV(U2X0);
+    UBRR0 = F_CPU / 8 / 115200 - 1;
+    UCSR0B = _BV(TXEN0);
+    fdev_setup_stream(&uart, uartPut, NULL, _FDEV_SETUP_WRITE);
+    stdout = &uart;
+    TCCR1A = 0;
+    TCCR1B = _BV(CS10);
+
+    Kalman reference;
+    KalmanQ16 fixed;
+    volatile double angle = 0;
+    volatile int32_t angleQ16 = 0;
+    uint32_t floatCycles = 0, fixedCycles = 0;
+    for (int i = 0; i < RUNS; i++) {
+        double acc = 180 + (i % 16) * 0.7, rate = 20 - (i % 8) * 3.1;
+        int32_t accQ16 = KalmanQ16::toFixed(acc), rateQ16 = KalmanQ16::toFixed(rate);
+
+        uint16_t start = cycles();
+        angle = reference.getAngle(acc, rate, 0.005);
+        floatCycles += (uint16_t)(cycles() - start);
+
+        start = cycles();
+        angleQ16 = fixed.getAngle(accQ16, rateQ16, 328);
+        fixedCycles += (uint16_t)(cycles() - start);
+    }
+    printf("Kalman %lu cycles, KalmanQ16 %lu cycles\n", floatCycles / RUNS, fixedCycles / RUNS);
+    for (;;);
+}
@@ -0,0 +1,115 @@
+// Host test: KalmanQ16 against the floating point Kalman on a simulated IMU,
+// and the sketch's 32 bit gyro step and complementary filter against the 64 bit
+// versions they replace. Build and run with `make -C test` from the smartboard directory.
+#include <math.h>
+#include <stdio.h>
+#include "../kalman.h"
+
+#define PROGMEM
+#define pgm_read_word(address) (*(address))
+typedef bool boolean;
+#include "../angle.ino"
+
+#define MAX_ERROR 0.05 // degrees between the fixed and float filters
+#define MAX_COMP_ERROR 0.01 // degrees between the 32 and 64 bit complementary filters
+
+// The sketch's constants at IMU_RATE_HZ 200
+static const int32_t IMU_DT_Q16 = 328;
+static const uint16_t COMP_ACC_WEIGHT_Q16 = 592;
+static const uint16_t GYRO_STEP_Q14 = (32018L * IMU_DT_Q16 + 128) >> 8;
+
+static uint32_t seed = 1;
+
+// Deterministic noise in -1..1
+static double noise() {
+    seed = seed * 1664525UL + 1013904223UL;
+    return (int32_t)seed / 2147483648.0;
+}
+
+// Runs both filters over `seconds` of a swinging tilt read at `hz`, with a
+// biased, noisy gyro and a noisy accelerometer angle. Returns the largest
+// difference between the two angle estimates.
+static double compare(int hz, double seconds, double bias, double accNoise) {
+    KalmanQ16::fixed_t dtQ16 = (65536L + hz / 2) / hz;
+    double dt = KalmanQ16::toDouble(dtQ16);
+    Kalman reference;
+    KalmanQ16 fixed;
+    reference.setAngle(180);
+    fixed.setAngle(KalmanQ16::toFixed(180));
+
+    double maxError = 0;
+    for (long i = 0; i < seconds * hz; i++) {
+        double t = i * dt;
+        double angle = 180 + 60 * sin(t * 1.3) + 20 * sin(t * 7.1);
+        double rate = 60 * 1.3 * cos(t * 1.3) + 20 * 7.1 * cos(t * 7.1);
+        double gyro = rate + bias + 0.5 * noise();
+        double acc = angle + accNoise * noise();
+        // Quantize the inputs the way the sketch does, so both filters see the same values
+        KalmanQ16::fixed_t gyroQ16 = KalmanQ16::toFixed(gyro);
+        KalmanQ16::fixed_t accQ16 = KalmanQ16::toFixed(acc);
+
+        double expected = reference.getAngle(KalmanQ16::toDouble(accQ16), KalmanQ16::toDouble(gyroQ16), dt);
+        double actual = KalmanQ16::toDouble(fixed.getAngle(accQ16, gyroQ16, dtQ16));
+        if (fabs(actual - expected) > maxError)
+            maxError = fabs(actual - expected);
+    }
+    return maxError;
+}
+
+// Runs the 64 bit gyro step and complementary filter the sketch used before
+// next to gyroStepQ16() and blendQ16() on raw readings. Returns the largest
+// difference between the two filtered angles; a step that differs by more than
+// one Q16 count counts as a failure too.
+static double compareComplementary(double seconds, double bias, double accNoise) {
+    int32_t before = KalmanQ16::toFixed(180), after = before;
+    double maxError = 0;
+    for (long i = 0; i < seconds * 200; i++) {
+        double t = i / 200.0;
+        double angle = 180 + 60 * sin(t * 1.3) + 20 * sin(t * 7.1);
+        double rate = 60 * 1.3 * cos(t * 1.3) + 20 * 7.1 * cos(t * 7.1);
+        long reading = lround((rate + bias + 0.5 * noise()) * 131);
+        int16_t raw = reading > 32767 ? 32767 : reading < -32768 ? -32768 : reading; // the sensor saturates
+        int32_t acc = deciToQ16(lround((angle + accNoise * noise()) * 10));
+
+        int32_t step64 = ((int64_t)(((int32_t)raw * 32018) >> 6) * IMU_DT_Q16) >> 16;
+        int32_t step32 = gyroStepQ16(raw, GYRO_STEP_Q14);
+        if (labs(step32 - step64) > 1)
+            return 360;
+        before += step64;
+        before -= ((int64_t)(before - acc) * COMP_ACC_WEIGHT_Q16) >> 16;
+        after = blendQ16(after + step32, acc, COMP_ACC_WEIGHT_Q16);
+
+        double error = fabs(KalmanQ16::toDouble(after - before));
+        if (error > maxError)
+            maxError = error;
+    }
+    return maxError;
+}
+
+int main() {
+    static const struct { int hz; double bias, accNoise; } cases[] = {
+        { 200, 3.0, 2.0 },  // the sketch's IMU_RATE_HZ
+        { 1000, -5.0, 2.0 },
+        { 25, 3.0, 2.0 },   // the old 40 ms report interval
+        { 200, 0.0, 10.0 },
+    };
+    int failed = 0;
+    for (unsigned i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        double error = compare(cases[i].hz, 120, cases[i].bias, cases[i].accNoise);
+        bool ok = error <= MAX_ERROR;
+        printf("%s %4d Hz bias %5.1f noise %4.1f: max error %.4f deg\n", ok ? "ok  " : "FAIL",
+               cases[i].hz, cases[i].bias, cases[i].accNoise, error);
+        failed += !ok;
+    }
+
+    // Full scale gyro readings and large angle differences included
+    static const struct { double bias, accNoise; } compCases[] = { { 3.0, 2.0 }, { -200.0, 2.0 }, { 0.0, 170.0 } };
+    for (unsigned i = 0; i < sizeof(compCases) / sizeof(compCases[0]); i++) {
+        double error = compareComplementary(120, compCases[i].bias, compCases[i].accNoise);
+        bool ok = error <= MAX_COMP_ERROR;
+        printf("%s complementary bias %6.1f noise %5.1f: max error %.4f deg\n", ok ? "ok  " : "FAIL",
+               compCases[i].bias, compCases[i].accNoise, error);
+        failed += !ok;
+    }
+    return failed != 0;
+}
@@ -19,9 +19,9 @@
      
 */
 
-#include <SoftwareSerial.h>
 #include <Servo.h>
 #include <DHT.h>
+#include "QuadratureEncoder.h"
 
 //Buzzer Set
 #define	BUZ_PORT		10
@@ -54,6 +54,7 @@
 #define WRT_BT      10
 #define RGBLED      11
 #define MOTOR       12
+#define ENCODER     14
         
 // Control Command
 #define GET         1
@@ -108,6 +109,11 @@ int analogs[6]={0,0,0,0,0,0};
 int digitals[14]={0,0,0,0,0,0,0,0,0,0,0,0,0,0};
 int servo_pins[8]={0,0,0,0,0,0,0,0};
 
+// Encoder: 핀 변화 인터럽트로 A, B 핀의 위치를 세고 보고 때마다 위치와 속도를 보냄
+#define ENCODER_COUNT 2
+QuadratureEncoder encoders[ENCODER_COUNT];
+int encoderPins[ENCODER_COUNT][2] = {{-1, -1}, {-1, -1}};
+
 // Variables
 float lastUltrasonic = 0;
 
@@ -308,6 +314,10 @@ void parseData()
             }
           }
         } 
+        else if(device == ENCODER) 
+        {
+          attachEncoder(readBuffer(6), readBuffer(7));
+        } 
         else if(port == trigPin || port == echoPin) 
         {
           setTempHumidityMode(false);          
@@ -319,6 +329,7 @@ void parseData()
           setTempHumidityMode(false);              
           setUltrasonicMode(false);
           setServoMode(false);          
+          if(device != ANALOG) releaseEncoder(port);
           digitals[port] = 0;
         }      
         break;
@@ -408,6 +419,11 @@ void runModule(int device)
     case TIMER:
             lastTime = millis()/1000.0; 
             break;
+
+    case ENCODER:
+            v = findEncoder(port);
+            if(v >= 0) encoders[v].setPosition(readLong(7));
+            break;
             
     case RGBLED: 
             setPortWritable(port);   
@@ -515,6 +531,15 @@ void sendPinValues()
     sendServoAngle();  
     callOK();      
   } 
+
+  for (int i = 0; i < ENCODER_COUNT; i++) 
+  {
+    if(encoderPins[i][0] >= 0) 
+    {
+      sendEncoder(i);
+      callOK();
+    }
+  }
   
 /*
  // for DEBUG
@@ -594,6 +619,97 @@ void sendServoAngle()
   writeEnd();
 }
 
+//
+int findEncoder(int pin) 
+{
+  for (int i = 0; i < ENCODER_COUNT; i++) 
+  {
+    if(encoderPins[i][0] == pin || encoderPins[i][1] == pin) return i;
+  }
+  return -1;
+}
+
+// 0, 1번은 시리얼이므로 2~13번만 사용
+void attachEncoder(int pinA, int pinB) 
+{
+  int slot = findEncoder(pinA);
+  if(slot >= 0 && encoderPins[slot][0] == pinA && encoderPins[slot][1] == pinB) return;
+  if(pinA < 2 || pinA > 13 || pinB < 2 || pinB > 13 || pinA == pinB) return;
+
+  releaseEncoder(pinA);
+  releaseEncoder(pinB);
+  slot = findEncoder(-1);
+  if(slot < 0) return;
+
+  if(pinA == trigPin || pinA == echoPin || pinB == trigPin || pinB == echoPin) setUltrasonicMode(false);
+  digitals[pinA] = 1;
+  digitals[pinB] = 1;
+
+  uint8_t oldSREG = SREG;
+  cli();
+  encoderPins[slot][0] = pinA;
+  encoderPins[slot][1] = pinB;
+  encoders[slot].begin(pinA, pinB);
+  *digitalPinToPCMSK(pinA) |= bit(digitalPinToPCMSKbit(pinA));
+  *digitalPinToPCMSK(pinB) |= bit(digitalPinToPCMSKbit(pinB));
+  PCICR |= bit(digitalPinToPCICRbit(pinA)) | bit(digitalPinToPCICRbit(pinB));
+  SREG = oldSREG;
+}
+
+// 엔코더 핀을 다른 장치로 쓰면 엔코더를 해제
+void releaseEncoder(int pin) 
+{
+  int slot = findEncoder(pin);
+  if(slot < 0) return;
+
+  uint8_t oldSREG = SREG;
+  cli();
+  for (int i = 0; i < 2; i++) 
+  {
+    int p = encoderPins[slot][i];
+    *digitalPinToPCMSK(p) &= ~bit(digitalPinToPCMSKbit(p));
+    encoderPins[slot][i] = -1;
+    digitals[p] = 0;
+  }
+  encoders[slot].end();
+  SREG = oldSREG;
+}
+
+//
+void updateEncoders() 
+{
+  for (uint8_t i = 0; i < ENCODER_COUNT; i++) 
+  {
+    if(encoders[i].attached()) encoders[i].update();
+  }
+}
+
+ISR(PCINT0_vect) 
+{
+  updateEncoders();
+}
+
+ISR(PCINT2_vect) 
+{
+  updateEncoders();
+}
+
+// 위치(long, 카운트), 속도(float, 초당 카운트)
+// 0xFF 0x55 7 위치 속도 A핀 B핀 ENCODER 0x0D 0x0A, 위치부터 B핀까지는 0x0D 뒤마다 0x00 을 끼움
+void sendEncoder(int slot) 
+{
+  writeHead();
+  writeSerial(7);
+  val.longVal = encoders[slot].position();
+  for (int i = 0; i < 4; i++) writeStuffed(val.byteVal[i]);
+  val.floatVal = encoders[slot].velocity();
+  for (int i = 0; i < 4; i++) writeStuffed(val.byteVal[i]);
+  writeStuffed(encoderPins[slot][0]);
+  writeStuffed(encoderPins[slot][1]);
+  writeSerial(ENCODER);
+  writeEnd();
+}
+
 //
 void sendDigitalValue(int pinNumber) 
 {
@@ -639,6 +755,13 @@ void writeSerial(unsigned char c)
   Serial.write(c);
 }
 
+// 값 안의 0x0D 0x0A 가 줄 끝으로 잘리지 않도록 0x0D 뒤에 0x00 을 붙임
+void writeStuffed(unsigned char c)
+{
+  writeSerial(c);
+  if(c == 13) writeSerial(0);
+}
+
 //
 void sendString(String s)
 {
@@ -714,6 +837,7 @@ int searchServoPin(int pin)
 //
 void setPortWritable(int pin) 
 {
+  releaseEncoder(pin);
   if(digitals[pin] == 0) 
   {
     digitals[pin] = 1;
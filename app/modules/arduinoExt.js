@@ -1,3 +1,7 @@
+var DeviceTimeline = require('./deviceTimeline');
+var ScopeCapture = require('./scopeCapture');
+var SampleStream = require('./sampleStream');
+
 function Module() {
     this.sp = null;
     this.sensorTypes = {
@@ -10,17 +14,24 @@ function Module() {
         PULSEIN: 6,
         ULTRASONIC: 7,
         TIMER: 8,
+        FILTER: 9,
+        SCOPE: 10,
+        STREAM: 11,
     };
 
     this.actionTypes = {
         GET: 1,
         SET: 2,
         RESET: 3,
+        STAMP: 7,
     };
 
     this.sensorValueSize = {
         FLOAT: 2,
         SHORT: 3,
+        PULSE: 5,
+        SCOPE: 8,
+        STREAM: 9,
     };
 
     this.digitalPortTimeList = [0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0];
@@ -52,9 +63,19 @@ function Module() {
             '5': 0,
         },
         PULSEIN: {},
+        PERIOD: {},
+        FREQUENCY: {},
         TIMER: 0,
+        SCOPE: {},
+        STREAM: {},
+        TIMESTAMP: 0,
+        LATENCY: 0,
     };
 
+    this.timeline = new DeviceTimeline();
+    this.scope = new ScopeCapture();
+    this.stream = new SampleStream();
+
     this.defaultOutput = {};
 
     this.recentCheckData = {};
@@ -90,6 +111,8 @@ Module.prototype.checkInitialData = function(data, config) {
 };
 
 Module.prototype.afterConnect = function(that, cb) {
+    this.timeline.reset();
+    this.sendBuffers.push(this.makeStampBuffer(true));
     that.connected = true;
     if (cb) {
         cb('connected');
@@ -259,14 +282,26 @@ Module.prototype.handleLocalData = function(data) {
         }
         var readData = data.subarray(2, data.length);
         var value;
+        var valueSize = 0;
         switch (readData[0]) {
             case self.sensorValueSize.FLOAT: {
                 value = new Buffer(readData.subarray(1, 5)).readFloatLE();
                 value = Math.round(value * 100) / 100;
+                valueSize = 4;
+                break;
+            }
+            case self.sensorValueSize.PULSE: {
+                // 주기(us), HIGH 시간(us), 주파수(Hz)
+                value = [1, 5, 9].map(function(offset) {
+                    var pulse = new Buffer(readData.subarray(offset, offset + 4)).readFloatLE();
+                    return Math.round(pulse * 100) / 100;
+                });
+                valueSize = 12;
                 break;
             }
             case self.sensorValueSize.SHORT: {
                 value = new Buffer(readData.subarray(1, 3)).readInt16LE();
+                valueSize = 2;
                 break;
             }
             default: {
@@ -278,6 +313,15 @@ Module.prototype.handleLocalData = function(data) {
         var type = readData[readData.length - 1];
         var port = readData[readData.length - 2];
 
+        // 타임스탬프가 켜져 있으면 값과 포트 사이에 2바이트 간격이 들어있다.
+        var portSize = type === self.sensorTypes.ULTRASONIC ? 2 : 1;
+        if (readData.length === 1 + valueSize + 2 + portSize + 1) {
+            self.sensorData.TIMESTAMP = self.timeline.advance(
+                readData.readUInt16LE(1 + valueSize)
+            );
+            self.sensorData.LATENCY = self.timeline.latency();
+        }
+
         switch (type) {
             case self.sensorTypes.DIGITAL: {
                 self.sensorData.DIGITAL[port] = value;
@@ -288,7 +332,9 @@ Module.prototype.handleLocalData = function(data) {
                 break;
             }
             case self.sensorTypes.PULSEIN: {
-                self.sensorData.PULSEIN[port] = value;
+                self.sensorData.PERIOD[port] = value[0];
+                self.sensorData.PULSEIN[port] = value[1];
+                self.sensorData.FREQUENCY[port] = value[2];
                 break;
             }
             case self.sensorTypes.ULTRASONIC: {
@@ -299,6 +345,33 @@ Module.prototype.handleLocalData = function(data) {
                 self.sensorData.TIMER = value;
                 break;
             }
+            case self.sensorTypes.SCOPE: {
+                var capture = self.scope.receive(
+                    readData.subarray(1, readData.length - 2)
+                );
+                if (capture) {
+                    capture.channel = port;
+                    self.sensorData.SCOPE = capture;
+                }
+                break;
+            }
+            // 시작할 때 한 번 채널당 실제 속도(FLOAT)가, 이후로는 샘플 프레임이 온다.
+            case self.sensorTypes.STREAM: {
+                if (readData[0] === self.sensorValueSize.FLOAT) {
+                    self.stream.start(value);
+                } else if (!self.stream.receive(readData.subarray(1, readData.length - 2))) {
+                    break;
+                }
+                self.sensorData.STREAM = {
+                    channel: port,
+                    rate: self.stream.rate,
+                    samples: self.stream.samples.slice(0, self.stream.channels),
+                    total: self.stream.total,
+                    overruns: self.stream.overruns,
+                    lost: self.stream.lost,
+                };
+                break;
+            }
             default: {
                 break;
             }
@@ -360,6 +433,22 @@ Module.prototype.makeSensorReadBuffer = function(device, port, data) {
     return buffer;
 };
 
+/*
+ff 55 len idx action(STAMP) on port a
+*/
+Module.prototype.makeStampBuffer = function(on) {
+    return new Buffer([
+        255,
+        85,
+        5,
+        sensorIdx,
+        this.actionTypes.STAMP,
+        on ? 1 : 0,
+        0,
+        10,
+    ]);
+};
+
 //0xff 0x55 0x6 0x0 0x1 0xa 0x9 0x0 0x0 0xa
 Module.prototype.makeOutputBuffer = function(device, port, data) {
     var buffer;
@@ -403,6 +492,70 @@ Module.prototype.makeOutputBuffer = function(device, port, data) {
             buffer = Buffer.concat([buffer, value, time, dummy]);
             break;
         }
+        // data: { debounce(ms), ema(1/256), median(창 크기), deadband }, 없으면 필터 해제
+        case this.sensorTypes.FILTER: {
+            var filter = $.isPlainObject(data) ? data : {};
+            var config = new Buffer(6);
+            config.writeUInt16LE(filter.debounce || 0, 0);
+            config.writeUInt8(filter.ema || 0, 2);
+            config.writeUInt8(filter.median || 0, 3);
+            config.writeUInt16LE(filter.deadband || 0, 4);
+            buffer = new Buffer([
+                255,
+                85,
+                10,
+                sensorIdx,
+                this.actionTypes.SET,
+                device,
+                port,
+            ]);
+            buffer = Buffer.concat([buffer, config, dummy]);
+            break;
+        }
+        // data: { rate(Hz), count, bits(8/10), edge(0 없음/1 상승/2 하강), level(0~1023) }, count 가 0 이면 취소
+        // 속도는 ADC 변환 속도(16MHz / 분주비(16~128) / 13)를 정수로 나눈 값으로만 맞출 수 있어, 펌웨어가 알려주는
+        // sensorData.SCOPE.rate 가 실제 속도다. 예: 50000 은 38461 이 되고, 5000 은 8비트에서 5128, 10비트에서 4808 이 된다.
+        // 10비트는 분주비 64 이상만 써서 최대 19231Hz 이고, 8비트는 최대 76923Hz 이다.
+        case this.sensorTypes.SCOPE: {
+            var scope = $.isPlainObject(data) ? data : {};
+            var capture = new Buffer(8);
+            capture.writeUInt16LE(scope.rate || 0, 0);
+            capture.writeUInt16LE(scope.count || 0, 2);
+            capture.writeUInt8(scope.bits || 8, 4);
+            capture.writeUInt8(scope.edge || 0, 5);
+            capture.writeUInt16LE(scope.level || 0, 6);
+            buffer = new Buffer([
+                255,
+                85,
+                12,
+                sensorIdx,
+                this.actionTypes.SET,
+                device,
+                port,
+            ]);
+            buffer = Buffer.concat([buffer, capture, dummy]);
+            break;
+        }
+        // data: { second(두 번째 채널, 없으면 한 채널), rate(채널당 Hz), delta(true 면 델타 방식) }, rate 가 0 이면 멈춤
+        // 속도는 SCOPE 와 같은 방식으로 맞춰지며(델타 방식은 10비트라 채널을 합쳐 최대 19231Hz), 실제 속도는 sensorData.STREAM.rate 로 온다.
+        case this.sensorTypes.STREAM: {
+            var stream = $.isPlainObject(data) ? data : {};
+            var settings = new Buffer(4);
+            settings.writeUInt8(stream.second === undefined ? 255 : stream.second, 0);
+            settings.writeUInt16LE(stream.rate || 0, 1);
+            settings.writeUInt8(stream.delta ? 1 : 0, 3);
+            buffer = new Buffer([
+                255,
+                85,
+                8,
+                sensorIdx,
+                this.actionTypes.SET,
+                device,
+                port,
+            ]);
+            buffer = Buffer.concat([buffer, settings, dummy]);
+            break;
+        }
         case this.sensorTypes.TONE: {
         }
     }
@@ -436,6 +589,13 @@ Module.prototype.reset = function() {
     this.lastSendTime = 0;
 
     this.sensorData.PULSEIN = {};
+    this.sensorData.PERIOD = {};
+    this.sensorData.FREQUENCY = {};
+    this.timeline.reset();
+    this.scope.reset();
+    this.sensorData.SCOPE = {};
+    this.stream.reset();
+    this.sensorData.STREAM = {};
 };
 
 module.exports = new Module();
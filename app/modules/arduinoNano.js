@@ -1,3 +1,6 @@
+var ScopeCapture = require('./scopeCapture');
+var SampleStream = require('./sampleStream');
+
 function Module() {
     this.sp = null;
     this.sensorTypes = {
@@ -10,6 +13,8 @@ function Module() {
         PULSEIN: 6,
         ULTRASONIC: 7,
         TIMER: 8,
+        SCOPE: 10,
+        STREAM: 11,
     };
 
     this.actionTypes = {
@@ -21,6 +26,9 @@ function Module() {
     this.sensorValueSize = {
         FLOAT: 2,
         SHORT: 3,
+        PULSE: 5,
+        SCOPE: 8,
+        STREAM: 9,
     };
 
     this.digitalPortTimeList = [0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0];
@@ -54,9 +62,16 @@ function Module() {
             '7': 0,
         },
         PULSEIN: {},
+        PERIOD: {},
+        FREQUENCY: {},
         TIMER: 0,
+        SCOPE: {},
+        STREAM: {},
     };
 
+    this.scope = new ScopeCapture();
+    this.stream = new SampleStream();
+
     this.defaultOutput = {};
 
     this.recentCheckData = {};
@@ -249,6 +264,14 @@ Module.prototype.handleLocalData = function(data) {
                 value = Math.round(value * 100) / 100;
                 break;
             }
+            case self.sensorValueSize.PULSE: {
+                // 주기(us), HIGH 시간(us), 주파수(Hz)
+                value = [1, 5, 9].map(function(offset) {
+                    var pulse = new Buffer(readData.subarray(offset, offset + 4)).readFloatLE();
+                    return Math.round(pulse * 100) / 100;
+                });
+                break;
+            }
             case self.sensorValueSize.SHORT: {
                 value = new Buffer(readData.subarray(1, 3)).readInt16LE();
                 break;
@@ -272,7 +295,9 @@ Module.prototype.handleLocalData = function(data) {
                 break;
             }
             case self.sensorTypes.PULSEIN: {
-                self.sensorData.PULSEIN[port] = value;
+                self.sensorData.PERIOD[port] = value[0];
+                self.sensorData.PULSEIN[port] = value[1];
+                self.sensorData.FREQUENCY[port] = value[2];
                 break;
             }
             case self.sensorTypes.ULTRASONIC: {
@@ -283,6 +308,33 @@ Module.prototype.handleLocalData = function(data) {
                 self.sensorData.TIMER = value;
                 break;
             }
+            case self.sensorTypes.SCOPE: {
+                var capture = self.scope.receive(
+                    readData.subarray(1, readData.length - 2)
+                );
+                if (capture) {
+                    capture.channel = port;
+                    self.sensorData.SCOPE = capture;
+                }
+                break;
+            }
+            // 시작할 때 한 번 채널당 실제 속도(FLOAT)가, 이후로는 샘플 프레임이 온다.
+            case self.sensorTypes.STREAM: {
+                if (readData[0] === self.sensorValueSize.FLOAT) {
+                    self.stream.start(value);
+                } else if (!self.stream.receive(readData.subarray(1, readData.length - 2))) {
+                    break;
+                }
+                self.sensorData.STREAM = {
+                    channel: port,
+                    rate: self.stream.rate,
+                    samples: self.stream.samples.slice(0, self.stream.channels),
+                    total: self.stream.total,
+                    overruns: self.stream.overruns,
+                    lost: self.stream.lost,
+                };
+                break;
+            }
             default: {
                 break;
             }
@@ -387,6 +439,50 @@ Module.prototype.makeOutputBuffer = function(device, port, data) {
             buffer = Buffer.concat([buffer, value, time, dummy]);
             break;
         }
+        // data: { rate(Hz), count, bits(8/10), edge(0 없음/1 상승/2 하강), level(0~1023) }, count 가 0 이면 취소
+        // 속도는 ADC 변환 속도(16MHz / 분주비(16~128) / 13)를 정수로 나눈 값으로만 맞출 수 있어, 펌웨어가 알려주는
+        // sensorData.SCOPE.rate 가 실제 속도다. 예: 50000 은 38461 이 되고, 5000 은 8비트에서 5128, 10비트에서 4808 이 된다.
+        // 10비트는 분주비 64 이상만 써서 최대 19231Hz 이고, 8비트는 최대 76923Hz 이다.
+        case this.sensorTypes.SCOPE: {
+            var scope = $.isPlainObject(data) ? data : {};
+            var capture = new Buffer(8);
+            capture.writeUInt16LE(scope.rate || 0, 0);
+            capture.writeUInt16LE(scope.count || 0, 2);
+            capture.writeUInt8(scope.bits || 8, 4);
+            capture.writeUInt8(scope.edge || 0, 5);
+            capture.writeUInt16LE(scope.level || 0, 6);
+            buffer = new Buffer([
+                255,
+                85,
+                12,
+                sensorIdx,
+                this.actionTypes.SET,
+                device,
+                port,
+            ]);
+            buffer = Buffer.concat([buffer, capture, dummy]);
+            break;
+        }
+        // data: { second(두 번째 채널, 없으면 한 채널), rate(채널당 Hz), delta(true 면 델타 방식) }, rate 가 0 이면 멈춤
+        // 속도는 SCOPE 와 같은 방식으로 맞춰지며(델타 방식은 10비트라 채널을 합쳐 최대 19231Hz), 실제 속도는 sensorData.STREAM.rate 로 온다.
+        case this.sensorTypes.STREAM: {
+            var stream = $.isPlainObject(data) ? data : {};
+            var settings = new Buffer(4);
+            settings.writeUInt8(stream.second === undefined ? 255 : stream.second, 0);
+            settings.writeUInt16LE(stream.rate || 0, 1);
+            settings.writeUInt8(stream.delta ? 1 : 0, 3);
+            buffer = new Buffer([
+                255,
+                85,
+                8,
+                sensorIdx,
+                this.actionTypes.SET,
+                device,
+                port,
+            ]);
+            buffer = Buffer.concat([buffer, settings, dummy]);
+            break;
+        }
         case this.sensorTypes.TONE: {
         }
     }
@@ -420,6 +516,12 @@ Module.prototype.reset = function() {
     this.lastSendTime = 0;
 
     this.sensorData.PULSEIN = {};
+    this.sensorData.SCOPE = {};
+    this.stream.reset();
+    this.sensorData.STREAM = {};
+    this.scope.reset();
+    this.sensorData.PERIOD = {};
+    this.sensorData.FREQUENCY = {};
 };
 
 module.exports = new Module();
@@ -16,6 +16,7 @@ function Module() {
         RGBLED: 12,
         DCMOTOR: 13,
         OLED: 14,
+        EDGE: 15,
     }
 
     this.actionTypes = {
@@ -28,7 +29,9 @@ function Module() {
     this.sensorValueSize = {
         FLOAT: 2,
         SHORT: 3,
-        STRING : 4
+        STRING : 4,
+        PULSE: 5,
+        EDGE: 6
     }
 
     this.digitalPortTimeList = [0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0];
@@ -61,8 +64,12 @@ function Module() {
         },
         PULSEIN: {
         },
+        PERIOD: {},
+        FREQUENCY: {},
         TIMER: 0,
-        READ_BLUETOOTH: 0
+        READ_BLUETOOTH: 0,
+        EDGE: {
+        }
     }
 
     this.defaultOutput = {
@@ -245,6 +252,14 @@ Module.prototype.handleLocalData = function(data) {
                 value = Math.round(value * 100) / 100;                    
                 break;
             }
+            case self.sensorValueSize.PULSE: {
+                // 주기(us), HIGH 시간(us), 주파수(Hz)
+                value = [1, 5, 9].map(function(offset) {
+                    var pulse = new Buffer(readData.subarray(offset, offset + 4)).readFloatLE();
+                    return Math.round(pulse * 100) / 100;
+                });
+                break;
+            }
             case self.sensorValueSize.SHORT: {
                 value = new Buffer(readData.subarray(1, 3)).readInt16LE();
                 break;
@@ -255,6 +270,19 @@ Module.prototype.handleLocalData = function(data) {
                 value = value.toString('ascii', 0, value.length);
                 break;
             }
+            case self.sensorValueSize.EDGE: {
+                // 개수 뒤에 변화마다 2바이트: 1 L aaaaaa, 1 aaaaaaa (레벨, 경과 ms)
+                value = [];
+                for (var i = 0; i < readData[1]; i++) {
+                    var high = readData[2 + i * 2];
+                    var low = readData[3 + i * 2];
+                    value.push({
+                        level: (high >> 6) & 1,
+                        age: ((high & 0x3f) << 7) | (low & 0x7f)
+                    });
+                }
+                break;
+            }
             default: {
                 value = 0;
                 break;
@@ -274,7 +302,9 @@ Module.prototype.handleLocalData = function(data) {
                 break;
             }
             case self.sensorTypes.PULSEIN: {
-                self.sensorData.PULSEIN[port] = value;
+                self.sensorData.PERIOD[port] = value[0];
+                self.sensorData.PULSEIN[port] = value[1];
+                self.sensorData.FREQUENCY[port] = value[2];
                 break;
             }
             case self.sensorTypes.ULTRASONIC: {
@@ -289,6 +319,10 @@ Module.prototype.handleLocalData = function(data) {
                 self.sensorData.READ_BLUETOOTH = value;
                 break;
             }
+            case self.sensorTypes.EDGE: {
+                self.handleEdges(port, value);
+                break;
+            }
             default: {
                 break;
             }
@@ -296,6 +330,22 @@ Module.prototype.handleLocalData = function(data) {
     });
 };
 
+// 보고 주기 사이에 지나간 짧은 입력도 rise/fall 횟수에 남는다
+Module.prototype.handleEdges = function(port, events) {
+    var now = Date.now();
+    var edge = this.sensorData.EDGE[port] || { rise: 0, fall: 0, level: 0, time: 0 };
+    events.forEach(function (event) {
+        if (event.level) {
+            edge.rise++;
+        } else {
+            edge.fall++;
+        }
+        edge.level = event.level;
+        edge.time = now - event.age;
+    });
+    this.sensorData.EDGE[port] = edge;
+};
+
 /*
 ff 55 len idx action device port  slot  data a
 0  1  2   3   4      5      6     7     8
@@ -540,6 +590,10 @@ Module.prototype.reset = function() {
 
      this.sensorData.PULSEIN = {
     }
+    this.sensorData.PERIOD = {};
+    this.sensorData.FREQUENCY = {};
+    this.sensorData.EDGE = {
+    }
 };
 
 module.exports = new Module();
@@ -0,0 +1,54 @@
+/**
+ * 펌웨어가 보고마다 붙이는 16비트 간격(4us 단위)을 누적해서 기기 기준의 시간축을 만든다.
+ * USB 시리얼의 묶음 전송 지연과 상관없이 샘플 사이 간격을 그대로 얻을 수 있다.
+ */
+class DeviceTimeline {
+    static get STAMP_MAX() {
+        return 0xFFFF;
+    }
+
+    constructor() {
+        this.reset();
+    }
+
+    reset() {
+        this.micros = 0;
+        this.origin = undefined;
+    }
+
+    /**
+     * 간격 하나만큼 시간축을 진행한다.
+     * STAMP_MAX 는 262ms 이상 보고가 끊겼다는 뜻이므로, 그만큼 지난 것으로 보되
+     * 실제 도착 시각이 더 늦으면 도착 시각에 맞춘다.
+     * @param {number} delta 4us 단위 간격
+     * @returns {number} 첫 보고부터의 기기 시간(ms)
+     */
+    advance(delta) {
+        const now = Date.now();
+        if (this.origin === undefined) {
+            this.origin = now;
+        } else if (delta === DeviceTimeline.STAMP_MAX) {
+            this.micros = Math.max(this.micros + delta * 4, (now - this.origin) * 1000);
+        } else {
+            this.micros += delta * 4;
+        }
+        return this.millis();
+    }
+
+    /**
+     * @returns {number} 첫 보고부터의 기기 시간(ms)
+     */
+    millis() {
+        return this.micros / 1000;
+    }
+
+    /**
+     * 마지막 보고가 기기 시간보다 얼마나 늦게 도착했는지. 첫 보고의 지연을 0 으로 본다.
+     * @returns {number} ms
+     */
+    latency() {
+        return this.origin === undefined ? 0 : Date.now() - this.origin - this.millis();
+    }
+}
+
+module.exports = DeviceTimeline;
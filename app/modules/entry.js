@@ -5,8 +5,13 @@ function Module() {
 	this.remoteDigitalValue = [0,0,0,0,0,0,0,0,0,0,0,0];
 	this.readablePorts = null;
 	this.remainValue = null;
+	this.reportPeriod = null;
+	this.sentReportPeriod = null;
 }
 
+// Analog write to this port sets the sensor board report period in ms
+var REPORT_PERIOD_PORT = 15;
+
 Module.prototype.init = function(handler, config) {
 };
 
@@ -31,6 +36,7 @@ Module.prototype.handleRemoteData = function(handler) {
 	for (var port = 0; port < 12; port++) {
 		digitalValue[port] = handler.read(port);
 	}
+	this.reportPeriod = handler.read('REPORT_PERIOD');
 };
 
 Module.prototype.requestLocalData = function() {
@@ -57,6 +63,14 @@ Module.prototype.requestLocalData = function() {
 			queryString.push(query);
 		}
 	}
+
+	var period = this.reportPeriod;
+	if (typeof period === 'number' && period !== this.sentReportPeriod) {
+		period = Math.max(0, Math.min(255, Math.round(period)));
+		queryString.push((6 << 5) + (REPORT_PERIOD_PORT << 1) + (period >> 7));
+		queryString.push(period & 127);
+		this.sentReportPeriod = this.reportPeriod;
+	}
 	return queryString;
 };
 
@@ -103,6 +117,7 @@ Module.prototype.requestRemoteData = function(handler) {
 };
 
 Module.prototype.reset = function() {
+	this.sentReportPeriod = null;
 };
 
 module.exports = new Module();
@@ -1,4 +1,5 @@
 const BaseModule = require('./baseModule');
+const DeviceTimeline = require('./deviceTimeline');
 
 class freearduino extends BaseModule {
 
@@ -14,11 +15,17 @@ class freearduino extends BaseModule {
             US_DISTANCE : 0,
             DHT_HUMI : 0,
             DHT_TEMP : 0,
+            SAMPLE_US : 0,
+            STEPPER_PROGRESS : {'1':100,'2':100,},
+            TIMESTAMP : 0,
+            LATENCY : 0,
         };
-        this.writeValue = new Array(32).fill(0);
-        this.lastValue = new Array(32).fill(0);
+        this.writeValue = new Array(36).fill(0);
+        this.lastValue = new Array(36).fill(0);
         this.readablePorts = [2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19];
         this.motorFlag = false;
+        this.timeline = new DeviceTimeline();
+        this.stampHigh = 0;
         
     }
     
@@ -50,7 +57,7 @@ class freearduino extends BaseModule {
     // 엔트리에서 받은 데이터에 대한 처리
     handleRemoteData(handler) {
         this.readablePorts = handler.read('readablePorts');
-        for (var port = 0; port < 32; port++) {
+        for (var port = 0; port < 36; port++) {
             this.writeValue[port] = handler.read(port);
         }
         if(this.writeValue[0] === 1 && !this.motorFlag) {
@@ -79,7 +86,7 @@ class freearduino extends BaseModule {
 
         var readablePortsValues =
         (readablePorts && Object.values(readablePorts)) || [];
-        for (var port = 2; port < 32; port++) {
+        for (var port = 2; port < 36; port++) {
             if ((port<20 && readablePortsValues.indexOf(port) > -1) ||
                 (port==20 && readablePortsValues.indexOf(3) > -1) ||
                 (port==21 && readablePortsValues.indexOf(5) > -1) ||
@@ -93,7 +100,7 @@ class freearduino extends BaseModule {
             var query = [128,0];
             var sendFlag = true;
 
-            if (port > 31) sendFlag = false;
+            if (port > 35) sendFlag = false;
             else if (value == 0 && this.lastValue[port] == 0) sendFlag = false;
             else if (port > 25 && !this.motorFlag) sendFlag = false;
 
@@ -106,7 +113,7 @@ class freearduino extends BaseModule {
                 query[0] |= (26<<1) | (number>>1);
                 query[1] |= ((number&1)<<6) | ((value%10)&63);
             }
-            if (port >= 27 && port <= 30) {
+            if (port >= 27 && port <= 35) {
                 query[0] |= (port<<1) | ((value>>7)&1);
                 query[1] |= value&127;
             }
@@ -154,8 +161,14 @@ class freearduino extends BaseModule {
                     if(port === 12) {
                         self.readValue.US_DISTANCE = value;
                     }
-                    //13
-                    //14
+                    else if(port === 13) {
+                        self.readValue.SAMPLE_US = value;
+                    }
+                    else if(port === 14) {
+                        // 프레임 샘플 시각, 직전 프레임과의 간격(4us 단위)의 하위 10비트
+                        self.readValue.TIMESTAMP = self.timeline.advance((self.stampHigh << 10) | value);
+                        self.readValue.LATENCY = self.timeline.latency();
+                    }
                 }
                 else if (port === 15) {
                     var port2 = first & 7;
@@ -167,9 +180,12 @@ class freearduino extends BaseModule {
                         var value = second & 127;
                         self.readValue.DHT_TEMP = value;
                     }
-                    //2
-                    //3
-                    //4
+                    else if (port2 === 2 || port2 === 3) {
+                        self.readValue.STEPPER_PROGRESS[port2 - 1] = second & 127;
+                    }
+                    else if (port2 === 4) {
+                        self.stampHigh = second & 63;
+                    }
                     //5
                     else if (port2 === 6) {
                         if (second >> 6 === 0) {
@@ -223,7 +239,10 @@ class freearduino extends BaseModule {
     }
     
     // 엔트리와의 연결 종료 후 처리 코드입니다.
-    reset() { };
+    reset() {
+        this.timeline.reset();
+        this.stampHigh = 0;
+    };
 }
 
 module.exports = new freearduino();
\ No newline at end of file
@@ -21,6 +21,7 @@ function Module() {
     this.sensorValueSize = {
         FLOAT: 2,
         SHORT: 3,
+        PULSE: 5,
     };
 
     this.digitalPortTimeList = [0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0];
@@ -52,6 +53,8 @@ function Module() {
             '5': 0,
         },
         PULSEIN: {},
+        PERIOD: {},
+        FREQUENCY: {},
         TIMER: 0,
     };
 
@@ -265,6 +268,14 @@ Module.prototype.handleLocalData = function(data) {
                 value = Math.round(value * 100) / 100;
                 break;
             }
+            case self.sensorValueSize.PULSE: {
+                // 주기(us), HIGH 시간(us), 주파수(Hz)
+                value = [1, 5, 9].map(function(offset) {
+                    var pulse = new Buffer(readData.subarray(offset, offset + 4)).readFloatLE();
+                    return Math.round(pulse * 100) / 100;
+                });
+                break;
+            }
             case self.sensorValueSize.SHORT: {
                 value = new Buffer(readData.subarray(1, 3)).readInt16LE();
                 break;
@@ -288,7 +299,9 @@ Module.prototype.handleLocalData = function(data) {
                 break;
             }
             case self.sensorTypes.PULSEIN: {
-                self.sensorData.PULSEIN[port] = value;
+                self.sensorData.PERIOD[port] = value[0];
+                self.sensorData.PULSEIN[port] = value[1];
+                self.sensorData.FREQUENCY[port] = value[2];
                 break;
             }
             case self.sensorTypes.ULTRASONIC: {
@@ -436,6 +449,8 @@ Module.prototype.reset = function() {
     this.lastSendTime = 0;
 
     this.sensorData.PULSEIN = {};
+    this.sensorData.PERIOD = {};
+    this.sensorData.FREQUENCY = {};
 };
 
 module.exports = new Module();
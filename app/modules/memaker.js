@@ -1,3 +1,5 @@
+var ScopeCapture = require('./scopeCapture');
+
 function Module() {
     this.sp = null;
     this.sensorTypes = {
@@ -11,7 +13,10 @@ function Module() {
         ULTRASONIC: 7,
         TIMER: 8,
         LCD: 9,
-        LCD_COMMAND: 10        
+        LCD_COMMAND: 10,
+        ENCODER: 14,
+        PID: 15,
+        PID_GAIN: 16
     }
 
     this.actionTypes = {
@@ -22,7 +27,8 @@ function Module() {
 
     this.sensorValueSize = {
         FLOAT: 2,
-        SHORT: 3
+        SHORT: 3,
+        ENCODER: 7
     }
 
     this.digitalPortTimeList = [0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0];
@@ -57,6 +63,8 @@ function Module() {
         },
         PULSEIN: {
         },
+        ENCODER: {
+        },
         TIMER: 0,
     }
 
@@ -229,7 +237,7 @@ Module.prototype.handleLocalData = function(data) {
             return;
         }
         var readData = data.subarray(2, data.length);
-        var value;
+        var value, encoderPin;
         switch(readData[0]) {
             case self.sensorValueSize.FLOAT: {
                 value = new Buffer(readData.subarray(1, 5)).readFloatLE();
@@ -240,6 +248,16 @@ Module.prototype.handleLocalData = function(data) {
                 value = new Buffer(readData.subarray(1, 3)).readInt16LE();
                 break;
             }
+            // 위치(long), 초당 카운트 속도(float), A핀, B핀, 0x0D 뒤마다 0x00 이 끼워져 있다.
+            case self.sensorValueSize.ENCODER: {
+                var encoder = ScopeCapture.unstuff(readData.subarray(1, readData.length - 1));
+                value = {
+                    position: encoder.readInt32LE(0),
+                    velocity: Math.round(encoder.readFloatLE(4) * 100) / 100
+                };
+                encoderPin = encoder[8];
+                break;
+            }
             default: {
                 value = 0;
                 break;
@@ -270,6 +288,11 @@ Module.prototype.handleLocalData = function(data) {
                 self.sensorData.TIMER = value;
                 break;
             }
+            // ff 55 7 위치 속도 A핀 B핀 ENCODER, A핀 기준으로 저장
+            case self.sensorTypes.ENCODER: {
+                self.sensorData.ENCODER[encoderPin] = value;
+                break;
+            }
             /*
             case self.sensorTypes.SOUND_IN: {
                 self.sensorData.ANALOG[port] = value;
@@ -291,7 +314,7 @@ ff 55 len idx action device port  slot  data a
 Module.prototype.makeSensorReadBuffer = function(device, port, data) {
     var buffer;
     var dummy = new Buffer([10]);
-    if(device == this.sensorTypes.ULTRASONIC) 
+    if(device == this.sensorTypes.ULTRASONIC || device == this.sensorTypes.ENCODER) 
     {
         buffer = new Buffer([255, 85, 6, sensorIdx, this.actionTypes.GET, device, port[0], port[1], 10]);
     }
@@ -336,6 +359,39 @@ Module.prototype.makeOutputBuffer = function(device, port, data) {
             buffer = Buffer.concat([buffer, value, dummy]);
             break;
         }
+        // data: 위치(long)
+        case this.sensorTypes.ENCODER: {
+            value = new Buffer(4);
+            value.writeInt32LE(data);
+            buffer = new Buffer([255, 85, 8, sensorIdx, this.actionTypes.SET, device, port]);
+            buffer = Buffer.concat([buffer, value, dummy]);
+            break;
+        }
+        // port: 0 왼쪽, 1 오른쪽 모터
+        // data: { mode: 0 끄기/1 엔코더 속도/2 엔코더 위치/3 아날로그, input, inputB, target }
+        case this.sensorTypes.PID: {
+            var target = new Buffer(4);
+            if($.isPlainObject(data)) {
+                target.writeInt32LE(data.target || 0);
+                buffer = new Buffer([255, 85, 11, sensorIdx, this.actionTypes.SET, device, port, data.mode, data.input, data.inputB || 0]);
+            } else {
+                target.writeInt32LE(0);
+                buffer = new Buffer([255, 85, 11, sensorIdx, this.actionTypes.SET, device, port, 0, 0, 0]);
+            }
+            buffer = Buffer.concat([buffer, target, dummy]);
+            break;
+        }
+        // data: { kp, ki, kd } 실수, 펌웨어에는 256 을 곱한 short 로 보냅니다.
+        case this.sensorTypes.PID_GAIN: {
+            var gains = new Buffer(6);
+            ['kp', 'ki', 'kd'].forEach(function(key, i) {
+                var gain = $.isPlainObject(data) ? Math.round((data[key] || 0) * 256) : 0;
+                gains.writeInt16LE(Math.max(-32768, Math.min(32767, gain)), i * 2);
+            });
+            buffer = new Buffer([255, 85, 10, sensorIdx, this.actionTypes.SET, device, port]);
+            buffer = Buffer.concat([buffer, gains, dummy]);
+            break;
+        }
         case this.sensorTypes.TONE: {
             var time = new Buffer(2);
             if($.isPlainObject(data)) {
@@ -491,6 +547,8 @@ Module.prototype.reset = function() {
 
      this.sensorData.PULSEIN = {
     }
+    this.sensorData.ENCODER = {
+    }
 };
 
 module.exports = new Module();
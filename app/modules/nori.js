@@ -1,3 +1,5 @@
+const DeviceTimeline = require('./deviceTimeline');
+
 function Module() {
     this.sp = null;
     this.sensorTypes = {
@@ -19,6 +21,7 @@ function Module() {
         TOUCH: 13,
         TEXTLCD: 14,
         SEGMENT: 15,
+        EDGE: 16,
     };
 
     this.actionTypes = {
@@ -28,12 +31,18 @@ function Module() {
         CFG: 4,
     };
 
+    this.configTypes = {
+        STAMP: 1,
+        EDGE: 2,
+    };
+
     this.sensorValueFormat = {
         INT8: 1,
         FLOAT: 2,
         SHORT: 3,
         TEXT: 4,
         TWINFLOAT: 5,
+        EDGE: 6,
     };
 
     this.magicCode = new Buffer([255, 45]);
@@ -52,8 +61,13 @@ function Module() {
             'port': 0,
             'value': 0,
         },
+        EDGE: {},
+        TIMESTAMP: 0,
+        LATENCY: 0,
     };
 
+    this.timeline = new DeviceTimeline();
+
     this.checkPhrase = 'HiNori!!';
 
     this.defaultOutput = {};
@@ -98,6 +112,9 @@ Module.prototype.checkInitialData = function(data, _) {
 };
 
 Module.prototype.afterConnect = function(that, cb) {
+    this.timeline.reset();
+    this.sendBuffers.push(this.makeConfigBuffer(this.configTypes.STAMP, 1));
+    this.sendBuffers.push(this.makeConfigBuffer(this.configTypes.EDGE, 1));
     that.connected = true;
     if (cb) {
         cb('connected');
@@ -241,11 +258,13 @@ Module.prototype.parsingPacket = function(data) {
 
     const readData = data.subarray(2, data.length);
     let value = 0;
+    let valueSize = 0;
 
     switch (readData[0]) {
         case this.sensorValueFormat.INT8: {
             value = new Buffer(readData.subarray(1, 2)).readInt8(0);
             value = Math.round(value * 100) / 100;
+            valueSize = 1;
             break;
         }
         case this.sensorValueFormat.TWINFLOAT: {
@@ -255,20 +274,39 @@ Module.prototype.parsingPacket = function(data) {
             ] 
             value[0] = Math.round(value[0] * 100) / 100;
             value[1] = Math.round(value[1] * 100) / 100;
+            valueSize = 8;
             break;
         }
         case this.sensorValueFormat.FLOAT: {
             value = new Buffer(readData.subarray(1, 5)).readFloatLE(0);
             value = Math.round(value * 100) / 100;
+            valueSize = 4;
             break;
         }
         case this.sensorValueFormat.SHORT: {
             value = new Buffer(readData.subarray(1, 3)).readInt16LE(0);
+            valueSize = 2;
             break;
         }
         case this.sensorValueFormat.TEXT: {
             const len = readData[1];
             value = new Buffer(readData.subarray(2, 2 + len)).toString();
+            valueSize = 1 + len;
+            break;
+        }
+        case this.sensorValueFormat.EDGE: {
+            // 개수 뒤에 이벤트마다 2바이트: 1 L aaaaaa, 1 aaaaaaa (레벨, 경과 ms)
+            const count = readData[1];
+            value = [];
+            for (let i = 0; i < count; i++) {
+                const high = readData[2 + i * 2];
+                const low = readData[3 + i * 2];
+                value.push({
+                    level: (high >> 6) & 1,
+                    age: ((high & 0x3f) << 7) | (low & 0x7f),
+                });
+            }
+            valueSize = 1 + count * 2;
             break;
         }
         default: {
@@ -280,10 +318,17 @@ Module.prototype.parsingPacket = function(data) {
     const type = readData[readData.length - 1];
     const port = readData[readData.length - 2];
 
+    // 타임스탬프가 켜져 있으면 값과 포트 사이에 2바이트 간격이 들어있다.
+    let stamp;
+    if (readData.length === 1 + valueSize + 2 + 2) {
+        stamp = readData.readUInt16LE(1 + valueSize);
+    }
+
     return {
         value,
         type,
         port,
+        stamp,
     };
 };
 
@@ -300,10 +345,20 @@ Module.prototype.handleLocalData = function(data) {
             return;
         }
 
+        if (result.type === self.sensorTypes.EDGE) {
+            self.handleEdges(result.port, result.value);
+            return;
+        }
+
         if (result.type !== self.sensorTypes.ALIVE) {
             self.sensorData.PORT[result.port] = result.value;
         }
 
+        if (result.stamp !== undefined) {
+            self.sensorData.TIMESTAMP = self.timeline.advance(result.stamp);
+            self.sensorData.LATENCY = self.timeline.latency();
+        }
+
         // self.sensorData.DEBUG.type = result.type;
         // self.sensorData.DEBUG.port = result.port;
         // self.sensorData.DEBUG.value = result.value;
@@ -314,6 +369,24 @@ Module.prototype.handleLocalData = function(data) {
     });
 };
 
+/**
+ * 버튼/터치 포트의 핀 변화를 누적한다.
+ * 보고 주기보다 짧은 눌림도 rise/fall 횟수에 남고, time 은 마지막 변화의 시각이다.
+ */
+Module.prototype.handleEdges = function(port, events) {
+    const now = Date.now();
+    const edge = this.sensorData.EDGE[port] || { rise: 0, fall: 0, level: 0, time: 0 };
+    events.forEach((event) => {
+        if (event.level) {
+            edge.rise++;
+        } else {
+            edge.fall++;
+        }
+        edge.level = event.level;
+        edge.time = now - event.age;
+    });
+    this.sensorData.EDGE[port] = edge;
+};
 
 Module.prototype.makePacket = function(device, port, action, payload) {
     const dummy = new Buffer([10]);
@@ -350,6 +423,15 @@ ff 2D len idx action device port  slot  data a
 0  1  2   3   4      5      6     7     8
 */
 
+/*
+ff 2D len idx action(CFG) config port value(short) a
+*/
+Module.prototype.makeConfigBuffer = function(config, data) {
+    const value = new Buffer(2);
+    value.writeInt16LE(data, 0);
+    return this.makePacket(config, 0, this.actionTypes.CFG, value);
+};
+
 Module.prototype.makeSensorReadBuffer = function(device, port, data) {
     let packet;
 
@@ -459,6 +541,8 @@ Module.prototype.reset = function() {
         '2': 0,
         '3': 0,
     };
+    this.sensorData.EDGE = {};
+    this.timeline.reset();
 };
 
 module.exports = new Module();
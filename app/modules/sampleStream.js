@@ -0,0 +1,109 @@
+var ScopeCapture = require('./scopeCapture');
+
+/**
+ * 펌웨어가 계속 보내는 STREAM 프레임을 풀어 채널별 최근 샘플 창을 유지한다.
+ * 순번이 건너뛰면 잃어버린 프레임 수를, 펌웨어가 보낸 값으로 링이 넘쳐 버린 묶음 수를 센다.
+ * 샘플은 8비트 방식이어도 0~1023 범위로 맞춘다.
+ */
+class SampleStream {
+    constructor(windowSize) {
+        this.windowSize = windowSize || SampleStream.WINDOW_SIZE;
+        this.reset();
+    }
+
+    reset() {
+        this.rate = 0;
+        this.channels = 1;
+        this.samples = [[], []];
+        this.total = 0;
+        this.overruns = 0;
+        this.lost = 0;
+        this.lastSeq = undefined;
+    }
+
+    /**
+     * 스트림 시작 때 펌웨어가 알려주는 채널당 실제 속도
+     * @param {number} rate Hz
+     */
+    start(rate) {
+        this.reset();
+        this.rate = rate;
+    }
+
+    /**
+     * 프레임 하나를 더한다.
+     * @param {Buffer} body 값 타입 바이트와 첫 채널 사이
+     * @returns {Array<number>|undefined} 채널별 마지막 샘플
+     */
+    receive(body) {
+        var bytes = ScopeCapture.unstuff(body);
+        if (bytes.length < 4) {
+            return undefined;
+        }
+        var seq = bytes[0];
+        var flags = bytes[3];
+        var channels = flags & 2 ? 2 : 1;
+        var values = flags & 1
+            ? SampleStream.decodeDelta(bytes, 4, channels)
+            : SampleStream.decodePacked(bytes, 4);
+
+        if (this.lastSeq !== undefined) {
+            this.lost += (seq - this.lastSeq - 1 + 256) % 256;
+        }
+        this.lastSeq = seq;
+        this.channels = channels;
+        this.overruns = bytes.readUInt16LE(1);
+
+        var self = this;
+        values.forEach(function(value, i) {
+            var window = self.samples[i % channels];
+            window.push(value);
+            if (window.length > self.windowSize) {
+                window.shift();
+            }
+        });
+        this.total += Math.floor(values.length / channels);
+        return this.samples.slice(0, channels).map(function(window) {
+            return window[window.length - 1];
+        });
+    }
+
+    static decodePacked(bytes, start) {
+        var values = [];
+        for (var i = start; i < bytes.length; i++) {
+            values.push(bytes[i] << 2);
+        }
+        return values;
+    }
+
+    // 채널마다 첫 값은 2바이트, 이후는 직전 값과의 차 한 바이트, 0x80 뒤에는 2바이트 값
+    static decodeDelta(bytes, start, channels) {
+        var values = [];
+        var last = [];
+        var i = start;
+        while (i < bytes.length) {
+            var channel = values.length % channels;
+            var value;
+            if (last[channel] === undefined || bytes[i] === 0x80) {
+                if (last[channel] !== undefined) {
+                    i++;
+                }
+                if (i + 2 > bytes.length) {
+                    break;
+                }
+                value = bytes.readUInt16LE(i);
+                i += 2;
+            } else {
+                value = last[channel] + bytes.readInt8(i);
+                i++;
+            }
+            last[channel] = value;
+            values.push(value);
+        }
+        return values;
+    }
+}
+
+SampleStream.WINDOW_SIZE = 512;
+
+module.exports = SampleStream;
@@ -0,0 +1,63 @@
+/**
+ * 펌웨어가 SCOPE_CHUNK 샘플씩 나눠 보내는 버스트 캡처 조각을 모아 한 번의 캡처로 만든다.
+ * 값 부분에는 0x0D 뒤마다 0x00 이 끼워져 있으므로 먼저 걷어낸다.
+ */
+class ScopeCapture {
+    constructor() {
+        this.reset();
+    }
+
+    reset() {
+        this.samples = null;
+    }
+
+    /**
+     * 조각 하나를 더한다. 중간 조각을 잃어버린 캡처는 버린다.
+     * @param {Buffer} body 값 타입 바이트와 채널 사이
+     * @returns {Object|undefined} 마지막 조각이면 { rate(Hz), bits, samples }
+     */
+    receive(body) {
+        var bytes = ScopeCapture.unstuff(body);
+        if (bytes.length < 7) {
+            return undefined;
+        }
+        var rate = bytes.readFloatLE(0);
+        var offset = bytes.readUInt16LE(4);
+        var flags = bytes[6];
+        var width = flags & 2 ? 2 : 1;
+
+        if (offset === 0) {
+            this.samples = [];
+        } else if (!this.samples || offset !== this.samples.length) {
+            this.samples = null;
+            return undefined;
+        }
+        for (var i = 7; i + width <= bytes.length; i += width) {
+            this.samples.push(width === 2 ? bytes.readUInt16LE(i) : bytes[i]);
+        }
+        if (!(flags & 1)) {
+            return undefined;
+        }
+
+        var capture = {
+            rate: Math.round(rate * 100) / 100,
+            bits: width === 2 ? 10 : 8,
+            samples: this.samples,
+        };
+        this.samples = null;
+        return capture;
+    }
+
+    static unstuff(body) {
+        var bytes = [];
+        for (var i = 0; i < body.length; i++) {
+            bytes.push(body[i]);
+            if (body[i] === 13) {
+                i++;
+            }
+        }
+        return Buffer.from(bytes);
+    }
+}
+
+module.exports = ScopeCapture;
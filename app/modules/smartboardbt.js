@@ -1,3 +1,13 @@
+// 100 ss ooo : servo sequence command, ss = servo port - 9
+var SEQUENCE = {
+	CLEAR: 0,
+	ADD: 1,
+	PLAY: 2,
+	LOOP: 3,
+	STOP: 4,
+	MAX: 16
+};
+
 function Module() {
 	this.digitalValue = new Array(14);
 	this.analogValue = new Array(6);
@@ -5,6 +15,13 @@ function Module() {
 	this.remoteDigitalValue = new Array(14);
 	this.readablePorts = null;
 	this.remainValue = null;
+
+	// { 12: { press: n, release: n, pressed: 0 | 1, time: ms }, ... }
+	this.buttonEvent = {};
+
+	// { 9: { points: [[position, speed], ...], mode: 'play' | 'loop' | 'stop', id: any }, ... }
+	this.remoteSequence = null;
+	this.sentSequence = {};
 }
 
 Module.prototype.init = function(handler, config) {
@@ -28,6 +45,7 @@ Module.prototype.handleRemoteData = function(handler) {
 	for (var port = 0; port < 14; port++) {
 		digitalValue[port] = handler.read(port);
 	}
+	this.remoteSequence = handler.read('SEQUENCE');
 };
 
 Module.prototype.requestLocalData = function() {
@@ -54,12 +72,51 @@ Module.prototype.requestLocalData = function() {
 			queryString.push(query);
 		}
 	}
+	this.requestSequenceData(queryString);
 	return queryString;
 };
 
+// Uploads changed servo sequences once; the board then plays them on its own
+Module.prototype.requestSequenceData = function(queryString) {
+	var sequence = this.remoteSequence;
+	if (!sequence) {
+		return;
+	}
+	for (var port = 9; port <= 11; port++) {
+		var request = sequence[port];
+		if (!request) {
+			continue;
+		}
+		var header = (4 << 5) + ((port - 9) << 3);
+		var sent = this.sentSequence[port] || {};
+		var points = (request.points || []).slice(0, SEQUENCE.MAX);
+		var pointsKey = JSON.stringify(points);
+		var commandKey = JSON.stringify([request.mode, request.id]);
+
+		if (pointsKey !== sent.points) {
+			queryString.push(header + SEQUENCE.CLEAR);
+			points.forEach(function(point) {
+				var position = point[0] & 255;
+				var speed = point[1] & 255;
+				queryString.push(header + SEQUENCE.ADD);
+				queryString.push(((position >> 7) & 1) | (((speed >> 7) & 1) << 1));
+				queryString.push(position & 127);
+				queryString.push(speed & 127);
+			});
+		}
+		if (pointsKey !== sent.points || commandKey !== sent.command) {
+			var mode = SEQUENCE[String(request.mode || 'stop').toUpperCase()];
+			if (mode === SEQUENCE.PLAY || mode === SEQUENCE.LOOP || mode === SEQUENCE.STOP) {
+				queryString.push(header + mode);
+			}
+		}
+		this.sentSequence[port] = { points: pointsKey, command: commandKey };
+	}
+};
+
 Module.prototype.handleLocalData = function(data) { // data: Native Buffer
 	var pointer = 0;
-	for (var i = 0; i < 32; i++) {
+	for (var i = 0; i < data.length; i++) {
 		var chunk;
 		if(!this.remainValue) {
 			chunk = data[i];
@@ -80,6 +137,16 @@ Module.prototype.handleLocalData = function(data) { // data: Native Buffer
 						(nextChunk & 127);
 				}				
 		    	i++;
+			} else if ((chunk >> 1) & 1) {
+				// 10 pppp 1 v : button edge, the next byte is its age in ms
+				var ageChunk = data[i + 1];
+				if(!ageChunk && ageChunk !== 0) {
+					this.remainValue = chunk;
+				} else {
+					this.remainValue = null;
+					this.handleButtonEvent((chunk >> 2) & 15, chunk & 1, ageChunk & 127);
+				}
+				i++;
 			} else {
 				var port = (chunk >> 2) & 15;
 				this.digitalValue[port] = chunk & 1;
@@ -88,6 +155,19 @@ Module.prototype.handleLocalData = function(data) { // data: Native Buffer
 	}
 };
 
+// Edges between two reports still count, so short taps are not lost
+Module.prototype.handleButtonEvent = function(port, pressed, age) {
+	var event = this.buttonEvent[port] || { press: 0, release: 0, pressed: 0, time: 0 };
+	if (pressed) {
+		event.press++;
+	} else {
+		event.release++;
+	}
+	event.pressed = pressed;
+	event.time = Date.now() - age;
+	this.buttonEvent[port] = event;
+};
+
 Module.prototype.requestRemoteData = function(handler) {
 	for (var i = 0; i < this.analogValue.length; i++) {
 		var value = this.analogValue[i];
@@ -97,9 +177,13 @@ Module.prototype.requestRemoteData = function(handler) {
 		var value = this.digitalValue[i];
 		handler.write(i, value);
 	}
+	handler.write('EVENT', this.buttonEvent);
 };
 
 Module.prototype.reset = function() {
+	this.remoteSequence = null;
+	this.sentSequence = {};
+	this.buttonEvent = {};
 };
 
 module.exports = new Module();
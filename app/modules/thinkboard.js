@@ -1,3 +1,5 @@
+var ScopeCapture = require('./scopeCapture');
+
 function Module()
 {
     this.sp = null;
@@ -17,6 +19,7 @@ function Module()
         RGBLED: 11,
         MOTOR: 12,
         LASER: 13,
+        ENCODER: 14,
     }
 
     this.actionTypes = 
@@ -31,7 +34,8 @@ function Module()
 	{
         FLOAT: 2,
         SHORT: 3,
-        STRING : 4
+        STRING : 4,
+        ENCODER: 7
     }
 
     this.digitalPortTimeList = [0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0];
@@ -84,6 +88,7 @@ function Module()
             '2': 0,
             '3': 0,						
 		},        
+        ENCODER: {},
         RD_BT: 0
     }
 
@@ -181,7 +186,7 @@ Module.prototype.handleLocalData = function(data)
         var type = readData[readData.length - 1];
         var port = readData[readData.length - 2];
 		
-        var value, value2;
+        var value, value2, encoderPin;
         switch(readData[0]) {
             case self.sensorValueSize.FLOAT: 
 			{
@@ -199,6 +204,15 @@ Module.prototype.handleLocalData = function(data)
                 value = new Buffer(readData.subarray(1, 3)).readInt16LE();
                 break;
             }
+            case self.sensorValueSize.ENCODER: {    // 위치(long), 초당 카운트 속도(float), A핀, B핀에 0x0D 뒤마다 0x00 이 끼워져 있음
+                var encoder = ScopeCapture.unstuff(readData.subarray(1, readData.length - 1));
+                value = {
+                    position: encoder.readInt32LE(0),
+                    velocity: Math.round(encoder.readFloatLE(4) * 100) / 100
+                };
+                encoderPin = encoder[8];
+                break;
+            }
             case self.sensorValueSize.STRING: {
                 value = new Buffer(readData[1] + 3);
                 value = readData.slice(2, readData[1] + 3);
@@ -243,6 +257,10 @@ Module.prototype.handleLocalData = function(data)
                 self.sensorData.RD_BT = value;
                 break;
             }
+            case self.sensorTypes.ENCODER: {    // ... A핀 B핀 ENCODER, A핀 기준으로 저장
+                self.sensorData.ENCODER[encoderPin] = value;
+                break;
+            }
             default: {
                 break;
             }
@@ -417,7 +435,7 @@ Module.prototype.makeSensorReadBuffer = function(device, port, data)
         buffer = new Buffer([255, 85, 5, sensorIdx, this.actionTypes.GET, device, port, 10]);    
 //        console.log("GET: %s %s %s %s", sensorIdx, this.actionTypes.GET, device, port);	                
     } 
-    else if(device == this.sensorTypes.SERVO) 
+    else if(device == this.sensorTypes.SERVO || device == this.sensorTypes.ENCODER) 
 	{
         buffer = new Buffer([255, 85, 6, sensorIdx, this.actionTypes.GET, device, port[0], port[1], 10]);	
 //        console.log("GET: %s %s %s %s %s", sensorIdx, this.actionTypes.GET, device, port[0], port[1]);	        
@@ -473,6 +491,13 @@ Module.prototype.makeOutputBuffer = function(device, port, data)
 				buffer = Buffer.concat([buffer, value, dummy]);
 				break;
 
+		case this.sensorTypes.ENCODER:      // 위치(long)
+				value = new Buffer(4);
+				value.writeInt32LE(data);
+				buffer = new Buffer([255, 85, 8, sensorIdx, this.actionTypes.SET, device, port]);
+				buffer = Buffer.concat([buffer, value, dummy]);
+				break;
+
 		case this.sensorTypes.BUZZER: 
                 buffer = new Buffer([255, 85, 5, sensorIdx, this.actionTypes.SET, device, port, data]);     
 				buffer = Buffer.concat([buffer, dummy]);
@@ -582,6 +607,7 @@ Module.prototype.reset = function()
 {
     this.lastTime = 0;
     this.lastSendTime = 0;
+    this.sensorData.ENCODER = {};
 };
 
 module.exports = new Module();
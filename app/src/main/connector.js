@@ -18,6 +18,79 @@ class Connector {
         return 1000;
     }
 
+    /**
+     * 자동 리셋(DTR) 보드는 포트를 열면 부트로더부터 다시 시작하므로, 식별 요청은
+     * IDENTIFY_INTERVAL 마다 다시 보내며 이 시간까지 기다린다. 하드웨어 옵션 identifyTimeout 으로 늘릴 수 있다.
+     */
+    static get IDENTIFY_TIMEOUT() {
+        return 2000;
+    }
+
+    static get IDENTIFY_INTERVAL() {
+        return 100;
+    }
+
+    /**
+     * 보드가 다른 데이터는 보내는데 식별 응답이 없으면 식별을 모르는 펌웨어로 보고 이 시간 뒤에 기존 handShake 로 넘어간다.
+     */
+    static get IDENTIFY_ANSWER_TIMEOUT() {
+        return 500;
+    }
+
+    /**
+     * 보드가 이미 응답하고 있을 때 보내는 한 번짜리 요청의 대기 시간
+     */
+    static get REQUEST_TIMEOUT() {
+        return 300;
+    }
+
+    /**
+     * 0xFF 0x55 계열 펌웨어에 보내는 식별 요청. (len, idx, action=IDENTIFY, device, port)
+     */
+    static get IDENTIFY_REQUEST() {
+        return [255, 85, 5, 0, 5, 0, 0, 10];
+    }
+
+    /**
+     * 펌웨어의 BAUD 명령 번호 순서대로의 통신 속도. 16MHz U2X 에서 250k 이상은 오차가 없다.
+     */
+    static get BAUD_RATES() {
+        return [115200, 250000, 500000, 1000000];
+    }
+
+    /**
+     * 펌웨어는 속도를 바꾼 뒤 이 시간 안에 확정을 받지 못하면 기본 속도로 돌아간다.
+     */
+    static get BAUD_CONFIRM_TIMEOUT() {
+        return 1000;
+    }
+
+    /**
+     * 식별 응답 ff 55 04 len "k=v;k=v..." 에서 디스크립터를 꺼낸다.
+     * @param {Buffer} data
+     * @returns {Object|undefined} 버전(v) 키가 없으면 undefined
+     */
+    static parseDescriptor(data) {
+        for (let i = 0; i + 4 <= data.length; i++) {
+            if (data[i] !== 255 || data[i + 1] !== 85 || data[i + 2] !== 4) {
+                continue;
+            }
+            const end = i + 4 + data[i + 3];
+            if (end > data.length) {
+                return undefined;
+            }
+            const descriptor = {};
+            data.slice(i + 4, end).toString('ascii').split(';').forEach((pair) => {
+                const split = pair.indexOf('=');
+                if (split > 0) {
+                    descriptor[pair.slice(0, split)] = pair.slice(split + 1);
+                }
+            });
+            return descriptor.v ? descriptor : undefined;
+        }
+        return undefined;
+    }
+
     constructor(hwModule, hardwareOptions) {
         this.options = hardwareOptions;
         this.hwModule = hwModule;
@@ -34,6 +107,12 @@ class Connector {
 
         this.connected = false;
         this.received = false;
+
+        /**
+         * 식별 응답으로 받은 보드 정보. identify 옵션이 없거나 응답이 없으면 undefined
+         * @type {Object}
+         */
+        this.descriptor = undefined;
     }
 
     /**
@@ -108,6 +187,151 @@ class Connector {
     };
 
     /**
+     * 식별 요청을 IDENTIFY_INTERVAL 마다 보내며 timeout 안에 디스크립터 응답을 기다린다.
+     * @param {number} timeout ms
+     * @param {number} [answerTimeout] 다른 데이터가 오기 시작하면 그때부터 이 시간까지만 기다린다.
+     * @returns {Promise<boolean>} 응답을 받았으면 true, 시간이 지나면 false
+     * @private
+     */
+    _identify(timeout, answerTimeout) {
+        return this._request(Connector.IDENTIFY_REQUEST, (data) => {
+            const descriptor = Connector.parseDescriptor(data);
+            if (descriptor) {
+                this.descriptor = descriptor;
+            }
+            return !!descriptor;
+        }, timeout, Connector.IDENTIFY_INTERVAL, answerTimeout);
+    }
+
+    /**
+     * 요청을 보내고 timeout 안에 isReply 를 만족하는 응답을 기다린다. 응답이 없으면 interval 마다 다시 보낸다.
+     * @param {Array<number>} request
+     * @param {function(Buffer): boolean} isReply
+     * @param {number} [timeout=REQUEST_TIMEOUT] ms
+     * @param {number} [interval=timeout] 다시 보내는 간격(ms), 기본값은 한 번만 보낸다.
+     * @param {number} [answerTimeout] 응답이 아닌 데이터가 처음 온 뒤로는 이 시간까지만 기다린다.
+     * @returns {Promise<boolean>} 응답을 받았으면 true
+     * @private
+     */
+    _request(request, isReply, timeout = Connector.REQUEST_TIMEOUT, interval = timeout, answerTimeout) {
+        return new Promise((resolve) => {
+            const serialPortReadStream =
+                        this.serialPort.parser ? this.serialPort.parser : this.serialPort;
+            const startedAt = Date.now();
+
+            const onData = (data) => {
+                if (isReply(data)) {
+                    finish(true);
+                } else if (answerTimeout !== undefined) {
+                    timeout = Math.min(timeout, Date.now() - startedAt + answerTimeout);
+                    answerTimeout = undefined;
+                }
+            };
+            const finish = (replied) => {
+                clearTimeout(this.requestTimer);
+                this.requestTimer = undefined;
+                serialPortReadStream.removeListener('data', onData);
+                resolve(replied);
+            };
+            const sendRequest = () => {
+                const left = timeout - (Date.now() - startedAt);
+                if (left <= 0 || !this.serialPort) {
+                    finish(false);
+                    return;
+                }
+                // send 는 이전 쓰기가 끝나지 않았으면 버리므로, 직전 재전송이 끝날 때까지 기다린다.
+                if (this.isSending) {
+                    this.requestTimer = setTimeout(sendRequest, 1);
+                    return;
+                }
+                this.send(Buffer.from(request));
+                this.requestTimer = setTimeout(sendRequest, Math.min(interval, left));
+            };
+
+            serialPortReadStream.on('data', onData);
+            sendRequest();
+        });
+    }
+
+    /**
+     * 시리얼포트의 통신 속도를 바꾼다.
+     * @param {number} baudRate
+     * @returns {Promise<void>}
+     * @private
+     */
+    _updateBaudRate(baudRate) {
+        return new Promise((resolve) => {
+            this.serialPort.update({ baudRate }, () => resolve());
+        });
+    }
+
+    /**
+     * 디스크립터의 최대 속도(s)와 maxBaudRate 옵션 중 작은 값부터 한 단계씩 내려가며 통신 속도를 올린다.
+     * 펌웨어는 응답을 보낸 뒤 속도를 바꾸고, BAUD_CONFIRM_TIMEOUT 안에 같은 BAUD 요청(확정)을
+     * 새 속도에서 다시 받아야 그 속도에 머문다. 확정은 새 속도의 식별 응답을 읽은 뒤에만 보낸다.
+     * 프로토콜에 체크섬이 없으므로 식별 응답이 깨지거나 오지 않으면 실패로 보고,
+     * 원래 속도로 돌아가 펌웨어가 스스로 돌아올 때까지 기다린 뒤 다음 속도를 시도한다.
+     * 확정을 보냈는데 응답을 못 받았으면 펌웨어가 확정했을 수 있으므로 두 속도를 모두 확인한다.
+     * @param {number} identifyTimeout 처음 식별에 쓴 시간(ms), 새 속도의 확인은 BAUD_CONFIRM_TIMEOUT 을 넘지 않는다.
+     * @returns {Promise<void>}
+     * @private
+     */
+    async _negotiateBaudRate(identifyTimeout) {
+        const { baudRate, maxBaudRate } = this.options;
+        const limit = Math.min(maxBaudRate || 0, Number(this.descriptor.s) || 0);
+
+        for (let code = Connector.BAUD_RATES.length - 1; code >= 0; code--) {
+            const rate = Connector.BAUD_RATES[code];
+            if (rate <= baudRate || !this.serialPort) {
+                return;
+            }
+            if (rate > limit) {
+                continue;
+            }
+
+            const request = [255, 85, 5, 0, 6, code, 0, 10];
+            const isAck = (data) => data.length >= 7 && data[0] === 255 && data[1] === 85 &&
+                data[2] === 3 && data[3] === code && data[4] === 0 &&
+                data[5] === 0 && data[6] === 0;
+            if (!await this._request(request, isAck) || !this.serialPort) {
+                return;
+            }
+
+            // 펌웨어가 되돌아가기 조금 전까지 확정을 마쳐야 한다.
+            const deadline = Date.now() + Connector.BAUD_CONFIRM_TIMEOUT - Connector.IDENTIFY_INTERVAL;
+            await this._updateBaudRate(rate);
+            const identified = await this._identify(Math.min(
+                identifyTimeout, deadline - Date.now() - Connector.REQUEST_TIMEOUT,
+            ));
+            if (identified && this.serialPort &&
+                await this._request(request, isAck, deadline - Date.now(), Connector.IDENTIFY_INTERVAL)) {
+                return;
+            }
+            if (!this.serialPort) {
+                return;
+            }
+
+            await this._updateBaudRate(baudRate);
+            await new Promise((resolve) => setTimeout(resolve, Connector.BAUD_CONFIRM_TIMEOUT));
+            if (identified && this.serialPort && !await this._identify(Connector.REQUEST_TIMEOUT)) {
+                // 확정 응답만 잃어버린 경우 펌웨어는 새 속도에 남아 있다.
+                if (!this.serialPort) {
+                    return;
+                }
+                await this._updateBaudRate(rate);
+                if (await this._identify(Connector.REQUEST_TIMEOUT) || !this.serialPort) {
+                    return;
+                }
+                await this._updateBaudRate(baudRate);
+                return;
+            }
+        }
+    }
+
+    /**
+     * identify 옵션이 켜진 경우 식별 요청을 먼저 보내고, 응답이 오면 바로 준비를 끝낸다.
+     * 디스크립터의 보드(b)가 board 옵션과 다르면 연결하지 않는다.
+     * 응답이 없는 펌웨어는 아래의 기존 handShake 로 넘어간다.
      * checkInitialData, requestInitialData 가 둘다 존재하는 경우 handShake 를 진행한다.
      * 둘 중 하나라도 없는 경우는 로직을 종료한다.
      * 만약 firmwareCheck 옵션이 활성화 된 경우면 executeFlash 를 세팅하고 종료한다.
@@ -121,6 +345,9 @@ class Connector {
                 control,
                 duration = Connector.DEFAULT_SLAVE_DURATION,
                 firmwarecheck,
+                identify,
+                identifyTimeout = Connector.IDENTIFY_TIMEOUT,
+                board,
             } = this.options;
             const hwModule = this.hwModule;
             const serialPortReadStream =
@@ -175,26 +402,65 @@ class Connector {
                 }, duration);
             };
 
-            if (firmwarecheck) {
-                this.flashFirmware = setTimeout(() => {
-                    if (this.serialPort) {
-                        this.serialPort.parser ?
-                            this.serialPort.parser.removeAllListeners('data') :
-                            this.serialPort.removeAllListeners('data');
-                        this.executeFlash = true;
-                    }
-                    resolve();
-                }, 3000);
-            }
+            // 식별 요청에 쓴 시간은 펌웨어 확인 대기에서 빼지 않도록 handShake 를 시작할 때 건다.
+            const checkFirmware = () => {
+                if (firmwarecheck) {
+                    this.flashFirmware = setTimeout(() => {
+                        if (this.serialPort) {
+                            this.serialPort.parser ?
+                                this.serialPort.parser.removeAllListeners('data') :
+                                this.serialPort.removeAllListeners('data');
+                            this.executeFlash = true;
+                        }
+                        resolve();
+                    }, 3000);
+                }
+            };
 
-            if (hwModule.checkInitialData && hwModule.requestInitialData) {
-                if (control === 'master') {
-                    runAsMaster();
+            const handShake = () => {
+                checkFirmware();
+                if (hwModule.checkInitialData && hwModule.requestInitialData) {
+                    if (control === 'master') {
+                        runAsMaster();
+                    } else {
+                        runAsSlave();
+                    }
                 } else {
-                    runAsSlave();
+                    resolve();
                 }
+            };
+
+            if (identify) {
+                this._identify(identifyTimeout, Connector.IDENTIFY_ANSWER_TIMEOUT).then((identified) => {
+                    if (!this.serialPort) {
+                        return;
+                    }
+                    if (!identified) {
+                        handShake();
+                        return;
+                    }
+                    // 다른 보드의 펌웨어다. 펌웨어 확인 옵션이 있으면 이 모듈의 펌웨어를 올리게 한다.
+                    if (board && this.descriptor.b !== board) {
+                        if (firmwarecheck) {
+                            this.executeFlash = true;
+                            resolve();
+                        } else {
+                            reject(new Error(`Invalid hardware: ${this.descriptor.b}`));
+                        }
+                        return;
+                    }
+                    return this._negotiateBaudRate(identifyTimeout).then(() => {
+                        if (!this.serialPort) {
+                            return;
+                        }
+                        if (hwModule.setSerialPort) {
+                            hwModule.setSerialPort(this.serialPort);
+                        }
+                        resolve();
+                    });
+                });
             } else {
-                resolve();
+                handShake();
             }
         });
     }
@@ -345,6 +611,10 @@ class Connector {
             clearTimeout(this.flashFirmware);
             this.flashFirmware = undefined;
         }
+        if (this.requestTimer) {
+            clearTimeout(this.requestTimer);
+            this.requestTimer = undefined;
+        }
     };
 
     close() {
@@ -179,9 +179,14 @@ class Scanner {
                     this.router.sendState('before_connect');
                 }
                 await connector.initialize();
+                if (connector.descriptor) {
+                    rendererConsole.info(`identified ${JSON.stringify(connector.descriptor)}`);
+                }
                 this.finalizeScan(connectedComName);
                 resolve(connector);
             } catch (e) {
+                // 다른 보드로 식별된 경우 등, 다음 스캔에서 다시 열 수 있도록 포트를 닫는다.
+                connector.close();
                 delete this.connectors[connectedComName];
                 reject(e);
             }
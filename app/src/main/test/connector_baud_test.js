@@ -0,0 +1,145 @@
+'use strict';
+/**
+ * Connector 의 통신 속도 협상을 펌웨어(setBaud, checkBaud)와 같은 규칙의 가짜 보드로 확인한다.
+ * 시리얼포트 패키지 없이 돌도록 require 를 막는다.
+ *
+ * node app/src/main/test/connector_baud_test.js
+ */
+const assert = require('assert');
+const EventEmitter = require('events');
+const Module = require('module');
+
+const load = Module._load;
+Module._load = function(request, ...args) {
+    if (request.startsWith('@serialport') || request.startsWith('@entrylabs')) {
+        return function() {};
+    }
+    return load.call(this, request, ...args);
+};
+const Connector = require('../connector');
+
+const BAUD_DEFAULT = 115200;
+const BAUD_CONFIRM_MS = 1000;
+
+/**
+ * 펌웨어처럼 응답을 보낸 뒤 속도를 바꾸고, 확정이 없으면 BAUD_CONFIRM_MS 뒤에 되돌아가는 보드.
+ * 양쪽 속도가 다르면 어느 쪽으로도 바이트가 전달되지 않는다.
+ * @param {Object} faults
+ * @param {function(Array<number>, number): boolean} [faults.dropRequest] (요청, 속도) 가 true 면 요청을 잃는다.
+ * @param {function(Array<number>, number): boolean} [faults.dropReply] (요청, 속도) 가 true 면 응답을 잃는다.
+ */
+function createBoard(faults = {}) {
+    const { dropRequest = () => false, dropReply = () => false } = faults;
+    const parser = new EventEmitter();
+    const board = {
+        rate: BAUD_DEFAULT,
+        code: 0xFF,
+        pending: false,
+        revertTimer: undefined,
+    };
+    const port = {
+        isOpen: true,
+        parser,
+        rate: BAUD_DEFAULT,
+        write(data, callback) {
+            const request = [...data];
+            const sentAt = port.rate;
+            setTimeout(() => {
+                callback();
+                if (sentAt !== board.rate || dropRequest(request, board.rate)) {
+                    return;
+                }
+                const reply = (bytes) => {
+                    if (port.rate === board.rate && !dropReply(request, board.rate)) {
+                        parser.emit('data', Buffer.from(bytes.concat([13, 10])));
+                    }
+                };
+                if (request[4] === 5) {
+                    const body = [...Buffer.from('v=1;b=arduino_ext;s=1000000')];
+                    reply([255, 85, 4, body.length].concat(body));
+                } else if (request[4] === 6) {
+                    const code = request[5];
+                    reply([255, 85, 3, code, 0, 0, 0]);
+                    if (code === board.code) {
+                        board.pending = false;
+                        clearTimeout(board.revertTimer);
+                        return;
+                    }
+                    board.rate = Connector.BAUD_RATES[code];
+                    board.code = code;
+                    board.pending = true;
+                    clearTimeout(board.revertTimer);
+                    board.revertTimer = setTimeout(() => {
+                        board.pending = false;
+                        board.code = 0xFF;
+                        board.rate = BAUD_DEFAULT;
+                    }, BAUD_CONFIRM_MS);
+                }
+            }, 2);
+        },
+        drain(callback) {
+            setTimeout(callback, 1);
+        },
+        update({ baudRate }, callback) {
+            port.rate = baudRate;
+            callback();
+        },
+    };
+    return { board, port };
+}
+
+async function negotiate(name, faults, expectedRate) {
+    const { board, port } = createBoard(faults);
+    const connector = new Connector({}, {
+        identify: true,
+        baudRate: BAUD_DEFAULT,
+        maxBaudRate: 1000000,
+        board: 'arduino_ext',
+    });
+    connector.serialPort = port;
+    await connector.initialize();
+    // 확정되지 않은 속도라면 이 사이에 보드가 되돌아간다.
+    await new Promise((resolve) => setTimeout(resolve, BAUD_CONFIRM_MS + 200));
+
+    assert.strictEqual(board.pending, false, `${name}: board is still waiting for a commit`);
+    assert.strictEqual(port.rate, board.rate, `${name}: host ${port.rate} and board ${board.rate} disagree`);
+    assert.strictEqual(port.rate, expectedRate, `${name}: settled at ${port.rate}`);
+    console.log(`${name}: ok (${port.rate})`);
+}
+
+const isIdentify = (request) => request[4] === 5;
+const isBaud = (request) => request[4] === 6;
+
+(async() => {
+    await negotiate('no fault', {}, 1000000);
+    await negotiate('1M dropped', {
+        dropRequest: (request, rate) => rate === 1000000,
+    }, 500000);
+    await negotiate('1M identify reply lost', {
+        dropReply: (request, rate) => rate === 1000000 && isIdentify(request),
+    }, 500000);
+    await negotiate('1M identify request received, reply lost once', (() => {
+        let lost = false;
+        return {
+            dropReply: (request, rate) => {
+                if (!lost && rate === 1000000 && isIdentify(request)) {
+                    lost = true;
+                    return true;
+                }
+                return false;
+            },
+        };
+    })(), 1000000);
+    await negotiate('BAUD request received, reply lost', {
+        dropReply: (request, rate) => rate === BAUD_DEFAULT && isBaud(request),
+    }, BAUD_DEFAULT);
+    await negotiate('commit received, reply lost', {
+        dropReply: (request, rate) => rate === 1000000 && isBaud(request),
+    }, 1000000);
+    await negotiate('commit lost', {
+        dropRequest: (request, rate) => rate === 1000000 && isBaud(request),
+    }, 500000);
+})().catch((error) => {
+    console.error(error.message);
+    process.exit(1);
+});